@@ -0,0 +1,253 @@
+#include "audio.h"
+#include "utils.h"
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define QUEUE_SIZE 256
+#define PATTERN_BITS (AUDIO_PATTERN_SIZE * 8)
+#define PHASE_BITS 25
+#define PHASE_ONE (1u << PHASE_BITS)
+#define PITCHES 256
+#define BUZZER_FREQUENCY 440.0f
+#define BUZZER_PATTERN 0xF0
+#define VOLUME (SHRT_MAX / 2)
+#define RAMP_SAMPLES 64
+#define NS_PER_SEC 1000000000LL
+#define LATENCY_NS 25000000LL
+#define MAX_AHEAD_NS 150000000LL
+
+/* head is only written by the consumer, tail only by the producer. */
+struct audio_queue {
+  AudioEvent events[QUEUE_SIZE];
+  uint32_t head;
+  uint32_t tail;
+  uint32_t dropped;
+};
+
+AUDIO_QUEUE audio_queue_init(void) {
+  AUDIO_QUEUE queue = calloc(1, sizeof(struct audio_queue));
+
+  if (queue == NULL)
+    terminate("Failed to allocate memory");
+
+  return queue;
+}
+
+void audio_queue_destroy(AUDIO_QUEUE queue) { free(queue); }
+
+/* Returns false and counts the event as dropped when the queue is full. */
+bool audio_queue_push(AUDIO_QUEUE queue, const AudioEvent *event) {
+  uint32_t tail = queue->tail;
+
+  if (tail - __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) == QUEUE_SIZE) {
+    __atomic_fetch_add(&queue->dropped, 1, __ATOMIC_RELAXED);
+    return false;
+  }
+
+  queue->events[tail % QUEUE_SIZE] = *event;
+  __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+static bool audio_queue_peek(AUDIO_QUEUE queue, AudioEvent *event) {
+  uint32_t head = queue->head;
+
+  if (head == __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE))
+    return false;
+
+  *event = queue->events[head % QUEUE_SIZE];
+  return true;
+}
+
+static void audio_queue_pop(AUDIO_QUEUE queue) {
+  __atomic_store_n(&queue->head, queue->head + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * The phase is a position in the pattern: the top 7 bits select one of its
+ * 128 bits and the low PHASE_BITS are the fraction within that bit, so it
+ * wraps around the pattern on its own.
+ *
+ * Event times are mapped onto the sample clock through offset, which is set
+ * on the first event so that it plays LATENCY_NS plus a buffer from now.
+ * That leaves the emulation thread a tick and some jitter to deliver the
+ * events of a tick before their samples are due.
+ */
+struct audio {
+  AUDIO_QUEUE queue;
+  uint32_t sample_rate;
+  int64_t sample;
+  int64_t offset;
+  bool synced;
+  uint32_t late;
+
+  float levels[PATTERN_BITS];
+  uint32_t phase;
+  uint32_t step;
+  float gain;
+  bool on;
+
+  ChipAudio sound;
+  uint32_t buzzer_step;
+  uint32_t pitch_steps[PITCHES];
+};
+
+static uint32_t bits_to_step(float bits_per_sec, uint32_t sample_rate) {
+  return (uint32_t)(bits_per_sec / sample_rate * PHASE_ONE);
+}
+
+static void load_pattern(AUDIO audio, const uint8_t *pattern) {
+  for (uint8_t bit = 0; bit < PATTERN_BITS; bit++)
+    audio->levels[bit] = pattern[bit >> 3] >> (7 - (bit & 7)) & 1 ? 1 : -1;
+}
+
+static void load_buzzer(AUDIO audio) {
+  uint8_t buzzer[AUDIO_PATTERN_SIZE];
+
+  memset(buzzer, BUZZER_PATTERN, sizeof(buzzer));
+  load_pattern(audio, buzzer);
+}
+
+AUDIO audio_init(uint32_t sample_rate, AUDIO_QUEUE queue) {
+  AUDIO audio = calloc(1, sizeof(struct audio));
+
+  if (audio == NULL)
+    terminate("Failed to allocate memory");
+
+  audio->queue = queue;
+  audio->sample_rate = sample_rate;
+
+  /* The buzzer pattern repeats every 8 bits. */
+  audio->buzzer_step = bits_to_step(BUZZER_FREQUENCY * 8, sample_rate);
+  for (uint16_t pitch = 0; pitch < PITCHES; pitch++)
+    audio->pitch_steps[pitch] = bits_to_step(
+        4000.0f * exp2f((pitch - AUDIO_DEFAULT_PITCH) / 48.0f), sample_rate);
+
+  load_buzzer(audio);
+  audio->step = audio->buzzer_step;
+  audio->sound.pitch = AUDIO_DEFAULT_PITCH;
+
+  return audio;
+}
+
+void audio_destroy(AUDIO audio) { free(audio); }
+
+/* Counters for the overlay, read from another thread. */
+AudioStats audio_get_stats(AUDIO audio) {
+  return (AudioStats){
+      .late = __atomic_load_n(&audio->late, __ATOMIC_RELAXED),
+      .dropped = audio->queue
+                     ? __atomic_load_n(&audio->queue->dropped, __ATOMIC_RELAXED)
+                     : 0};
+}
+
+/* Switches to the sound of the event, keeping the phase of a held note. */
+static void apply_event(AUDIO audio, const AudioEvent *event) {
+  const ChipAudio *sound = &event->sound;
+
+  if (!sound->pattern_loaded) {
+    if (audio->sound.pattern_loaded)
+      load_buzzer(audio);
+    audio->step = audio->buzzer_step;
+  } else {
+    if (memcmp(audio->sound.pattern, sound->pattern, AUDIO_PATTERN_SIZE) ||
+        !audio->sound.pattern_loaded)
+      load_pattern(audio, sound->pattern);
+    audio->step = audio->pitch_steps[sound->pitch];
+  }
+
+  if (event->on && !audio->on && audio->gain == 0)
+    audio->phase = 0;
+  audio->on = event->on;
+  audio->sound = *sound;
+}
+
+/*
+ * Sample the event is due at. Events that come too late play right away
+ * and push the later ones back by as much; events too far ahead, after the
+ * emulation skipped time, move the clock forward.
+ */
+static int64_t event_sample(AUDIO audio, const AudioEvent *event, int64_t now,
+                            uint32_t frames) {
+  int64_t rate = audio->sample_rate;
+  int64_t at = event->time / NS_PER_SEC * rate +
+               event->time % NS_PER_SEC * rate / NS_PER_SEC;
+  int64_t latency = LATENCY_NS * rate / NS_PER_SEC + frames;
+
+  if (!audio->synced || at + audio->offset > now + MAX_AHEAD_NS * rate /
+                                                       NS_PER_SEC) {
+    audio->offset = now + latency - at;
+    audio->synced = true;
+  } else if (at + audio->offset < now) {
+    __atomic_store_n(&audio->late, audio->late + 1, __ATOMIC_RELAXED);
+    audio->offset = now - at;
+  }
+
+  return at + audio->offset;
+}
+
+/*
+ * A step between two pattern bits is rounded off over the samples closest
+ * to it. That only works while a bit lasts at least two samples, higher
+ * pitches are played without it. Gain ramps over RAMP_SAMPLES when the
+ * sound starts or stops, so neither clicks.
+ */
+static void synth(AUDIO audio, int16_t *out, uint32_t frames) {
+  float dt = (float)audio->step / PHASE_ONE;
+  float target = audio->on ? 1 : 0;
+  bool smooth = dt < 0.5f;
+
+  if (audio->gain == target && !audio->on) {
+    memset(out, 0, frames * sizeof(int16_t));
+    return;
+  }
+
+  for (uint32_t i = 0; i < frames; i++) {
+    uint8_t bit = audio->phase >> PHASE_BITS;
+    float t = (float)(audio->phase & (PHASE_ONE - 1)) / PHASE_ONE;
+    float level = audio->levels[bit];
+
+    if (smooth && t < dt) {
+      float x = t / dt;
+      float prev = audio->levels[(bit - 1) & (PATTERN_BITS - 1)];
+
+      level += (level - prev) * 0.5f * (x + x - x * x - 1);
+    } else if (smooth && t > 1 - dt) {
+      float x = (t - 1) / dt;
+      float next = audio->levels[(bit + 1) & (PATTERN_BITS - 1)];
+
+      level += (next - level) * 0.5f * (x * x + x + x + 1);
+    }
+
+    if (audio->gain < target)
+      audio->gain = fminf(audio->gain + 1.0f / RAMP_SAMPLES, target);
+    else if (audio->gain > target)
+      audio->gain = fmaxf(audio->gain - 1.0f / RAMP_SAMPLES, target);
+
+    out[i] = (int16_t)(level * audio->gain * VOLUME);
+    audio->phase += audio->step;
+  }
+}
+
+/* Fills the buffer with mono samples, applying every event that falls in. */
+void audio_render(AUDIO audio, int16_t *out, uint32_t frames) {
+  uint32_t done = 0;
+  AudioEvent event;
+
+  while (audio->queue && audio_queue_peek(audio->queue, &event)) {
+    int64_t at = event_sample(audio, &event, audio->sample + done, frames);
+
+    if (at >= audio->sample + frames)
+      break;
+
+    synth(audio, out + done, (uint32_t)(at - audio->sample) - done);
+    done = (uint32_t)(at - audio->sample);
+    apply_event(audio, &event);
+    audio_queue_pop(audio->queue);
+  }
+
+  synth(audio, out + done, frames - done);
+  audio->sample += frames;
+}
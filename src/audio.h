@@ -0,0 +1,42 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include "chip.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Sound events on their way from the emulation thread to the audio thread,
+ * stamped with the emulated time in nanoseconds. The queue has a single
+ * producer and a single consumer and takes no locks.
+ */
+typedef struct AudioEvent {
+  int64_t time;
+  bool on;
+  ChipAudio sound;
+} AudioEvent;
+typedef struct audio_queue *AUDIO_QUEUE;
+
+AUDIO_QUEUE audio_queue_init(void);
+void audio_queue_destroy(AUDIO_QUEUE);
+bool audio_queue_push(AUDIO_QUEUE, const AudioEvent *);
+
+/*
+ * A single voice playing the chip sound: the XO-CHIP pattern at its pitch,
+ * or the plain buzzer when no pattern was loaded. It follows the events of
+ * its queue to the sample. Edges are smoothed with PolyBLEP, so the wave
+ * stays band-limited without any per-sample math beyond a few
+ * multiplications.
+ */
+typedef struct audio *AUDIO;
+typedef struct AudioStats {
+  uint32_t late;
+  uint32_t dropped;
+} AudioStats;
+
+AUDIO audio_init(uint32_t, AUDIO_QUEUE);
+void audio_destroy(AUDIO);
+void audio_render(AUDIO, int16_t *, uint32_t);
+AudioStats audio_get_stats(AUDIO);
+
+#endif
@@ -0,0 +1,478 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "args.h"
+#include "chip.h"
+#include "config.h"
+#include "pool.h"
+#include "rompack.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_FRAMES 600
+#define DEFAULT_CPF 1000
+#define MAX_LINE_SIZE 4096
+
+/*
+ * One line of the rom list together with the result of its run. Workers
+ * only write the result fields of their own job. Roms from a pack point
+ * into its mapping, other roms are read from path.
+ */
+typedef struct {
+  char *path;
+  const uint8_t *rom;
+  size_t rom_size;
+  uint8_t quirks;
+  uint32_t frames;
+  uint64_t cycles;
+  uint16_t cpf;
+  uint64_t seed;
+  const ChipCore *core;
+
+  const char *exit;
+  const char *error;
+  uint16_t pc;
+  uint32_t frames_run;
+  uint64_t cycles_run;
+  uint64_t vram_hash;
+  double wall_time;
+} BatchJob;
+
+typedef struct {
+  BatchJob *jobs;
+  size_t count;
+  size_t capacity;
+} BatchList;
+
+Config *parse_args_into_config(int argc, char **argv) {
+  Config *config = config_init();
+
+  ArgParserOptions *options = args_init_options(10);
+  args_add_options(
+      options, 10,
+      (ArgParserOption){.lng = "frames",
+                        .shrt = 'n',
+                        .description = "default number of 60 Hz frames to run "
+                                       "each rom. Default: 600",
+                        .parse = &parse_uint_arg_value,
+                        .set = &config_set_frames},
+      (ArgParserOption){.lng = "cycles",
+                        .shrt = 'c',
+                        .description = "default number of chip cycles to run "
+                                       "each rom",
+                        .parse = &parse_uint_arg_value,
+                        .set = &config_set_cycles},
+      (ArgParserOption){.lng = "cpf",
+                        .shrt = 'p',
+                        .description = "default chip cycles per frame. "
+                                       "Default: 1000",
+                        .parse = &parse_uint_arg_value,
+                        .set = &config_set_cpf},
+      (ArgParserOption){.lng = "quirk",
+                        .shrt = 'q',
+                        .description = "enable a quirk for every rom that "
+                                       "doesn't set its own",
+                        .parse = &parse_chip_quirk_arg_value,
+                        .set = &config_set_chip_quirks},
+      (ArgParserOption){.lng = "threads",
+                        .shrt = 't',
+                        .description = "number of worker threads. Default: "
+                                       "number of cores",
+                        .parse = &parse_uint_arg_value,
+                        .set = &config_set_threads},
+      (ArgParserOption){.lng = "output",
+                        .shrt = 'o',
+                        .description = "write results to a file instead of "
+                                       "stdout",
+                        .parse = &parse_string_arg_value,
+                        .set = &config_set_output},
+      (ArgParserOption){.lng = "core",
+                        .shrt = 'k',
+                        .description = "core for every rom that doesn't set "
+                                       "its own: chip-8, super-chip or "
+                                       "xo-chip. Default: picked from each "
+                                       "rom",
+                        .parse = &parse_core_arg_value,
+                        .set = &config_set_core},
+      (ArgParserOption){.lng = "seed",
+                        .shrt = 's',
+                        .description = "default seed for the random number "
+                                       "generator. Default: 0",
+                        .parse = &parse_uint_arg_value,
+                        .set = &config_set_seed},
+      (ArgParserOption){.lng = "pack",
+                        .shrt = 'a',
+                        .description = "look up the roms of the list in a "
+                                       "rom pack",
+                        .parse = &parse_string_arg_value,
+                        .set = &config_set_pack},
+      (ArgParserOption){.lng = "help",
+                        .shrt = 'h',
+                        .description = "display this help and exit",
+                        .parse = &display_help_message,
+                        .set = NULL});
+
+  args_parse(options, argc, argv, config);
+  args_destroy(options);
+
+  return config;
+}
+
+static uint8_t parse_quirks(char *value) {
+  uint8_t quirks = 0;
+
+  for (char *name = strtok(value, ","); name; name = strtok(NULL, ",")) {
+    uint8_t *quirk = parse_chip_quirk_arg_value(NULL, name, NULL);
+    quirks |= *quirk;
+    free(quirk);
+  }
+
+  return quirks;
+}
+
+static unsigned long long parse_number(const char *value, size_t line) {
+  char *end;
+  unsigned long long number = strtoull(value, &end, 10);
+
+  if (end == value || *end != '\0') {
+    fprintf(stderr, "Wrong number on line %zu: %s\n", line, value);
+    exit(EXIT_FAILURE);
+  }
+
+  return number;
+}
+
+/*
+ * Sets the defaults of a job: what the pack recommends for the rom, if it
+ * comes from one, and the command line settings otherwise.
+ */
+static void init_job(BatchJob *job, const char *path, const PackRom *rom,
+                     const Config *config) {
+  memset(job, 0, sizeof(BatchJob));
+  job->quirks = config->chip_quirks;
+  job->frames = config->frames;
+  job->cycles = config->cycles;
+  job->seed = config->seed;
+  job->cpf = config->cpf ? config->cpf : DEFAULT_CPF;
+  job->core = config->core;
+
+  job->path = strdup(path);
+  if (job->path == NULL)
+    terminate("Failed to allocate memory");
+
+  if (rom != NULL) {
+    job->rom = rom->data;
+    job->rom_size = rom->size;
+    if (rom->core != NULL)
+      job->core = rom->core;
+    if (rom->quirks_set)
+      job->quirks = rom->quirks;
+  }
+}
+
+/*
+ * Parses "<rom> [quirks=a,b] [frames=N] [cycles=N] [cpf=N] [seed=N]
+ * [core=name]", backend= being read as core= for older lists.
+ * Settings missing on a line fall back to the pack, if the rom is looked up
+ * in one, and then to the command line ones.
+ */
+static void parse_job(BatchJob *job, char *line, size_t lineno,
+                      const Config *config, ROMPACK pack) {
+  PackRom rom;
+  bool found = false;
+  char *fields[9];
+  size_t count = 0;
+
+  for (char *tok = strtok(line, " \t\r\n"); tok && count < 9;
+       tok = strtok(NULL, " \t\r\n"))
+    fields[count++] = tok;
+
+  if (pack != NULL)
+    found = rompack_find(pack, fields[0], &rom);
+  init_job(job, fields[0], found ? &rom : NULL, config);
+  if (pack != NULL && !found) {
+    job->exit = "error";
+    job->error = "rom is not in the pack";
+  }
+
+  for (size_t i = 1; i < count; i++) {
+    char *value = strchr(fields[i], '=');
+
+    if (value == NULL) {
+      fprintf(stderr, "Expected key=value on line %zu: %s\n", lineno,
+              fields[i]);
+      exit(EXIT_FAILURE);
+    }
+    *value++ = '\0';
+
+    if (strcmp(fields[i], "quirks") == 0) {
+      char *quirks = strdup(value);
+      job->quirks = parse_quirks(quirks);
+      free(quirks);
+    } else if (strcmp(fields[i], "frames") == 0) {
+      job->frames = parse_number(value, lineno);
+    } else if (strcmp(fields[i], "cycles") == 0) {
+      job->cycles = parse_number(value, lineno);
+    } else if (strcmp(fields[i], "cpf") == 0) {
+      job->cpf = parse_number(value, lineno);
+    } else if (strcmp(fields[i], "seed") == 0) {
+      job->seed = parse_number(value, lineno);
+    } else if (strcmp(fields[i], "core") == 0 ||
+               strcmp(fields[i], "backend") == 0) {
+      job->core = chip_find_core(value);
+      if (job->core == NULL) {
+        fprintf(stderr, "Unknown core on line %zu: %s\n", lineno, value);
+        exit(EXIT_FAILURE);
+      }
+    } else {
+      fprintf(stderr, "Unknown setting on line %zu: %s\n", lineno, fields[i]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (job->frames == 0 && job->cycles == 0)
+    job->frames = DEFAULT_FRAMES;
+  if (job->cpf == 0)
+    job->cpf = DEFAULT_CPF;
+}
+
+static void grow_list(BatchList *list) {
+  BatchJob *jobs;
+
+  if (list->count < list->capacity)
+    return;
+
+  list->capacity *= 2;
+  jobs = realloc(list->jobs, list->capacity * sizeof(BatchJob));
+  if (jobs == NULL)
+    terminate("Failed to allocate memory");
+  list->jobs = jobs;
+}
+
+static BatchList read_rom_list(const char *filename, const Config *config,
+                               ROMPACK pack) {
+  BatchList list = {.count = 0, .capacity = 64};
+  char line[MAX_LINE_SIZE];
+  size_t lineno = 0;
+  FILE *fp = fopen(filename, "r");
+
+  if (!fp) {
+    printf("Failed to open %s\n", filename);
+    exit(EXIT_FAILURE);
+  }
+
+  list.jobs = malloc(list.capacity * sizeof(BatchJob));
+  if (list.jobs == NULL)
+    terminate("Failed to allocate memory");
+
+  while (fgets(line, sizeof(line), fp)) {
+    char *start = line + strspn(line, " \t");
+
+    lineno++;
+    if (*start == '#' || *start == '\n' || *start == '\r' || *start == '\0')
+      continue;
+
+    grow_list(&list);
+    parse_job(&list.jobs[list.count++], start, lineno, config, pack);
+  }
+
+  fclose(fp);
+
+  return list;
+}
+
+/* Makes a job of every rom in the pack, in the order of the index. */
+static BatchList read_rom_pack(ROMPACK pack, const Config *config) {
+  BatchList list = {.count = 0, .capacity = 64};
+  PackRom rom;
+
+  list.jobs = malloc(list.capacity * sizeof(BatchJob));
+  if (list.jobs == NULL)
+    terminate("Failed to allocate memory");
+
+  for (size_t i = 0; i < rompack_count(pack); i++) {
+    BatchJob *job;
+
+    grow_list(&list);
+    job = &list.jobs[list.count++];
+    if (rompack_get(pack, i, &rom)) {
+      init_job(job, rom.name, &rom, config);
+    } else {
+      init_job(job, "?", NULL, config);
+      job->exit = "error";
+      job->error = "broken rom pack entry";
+    }
+
+    if (job->frames == 0 && job->cycles == 0)
+      job->frames = DEFAULT_FRAMES;
+  }
+
+  return list;
+}
+
+/*
+ * The first argument is a rom pack, whose roms are all run, or a list, whose
+ * roms are looked up in --pack when it is given.
+ */
+static BatchList read_jobs(const char *arg, const Config *config,
+                           ROMPACK *pack) {
+  const char *path = config->pack ? config->pack : arg;
+  const char *error = rompack_open(path, pack);
+
+  if (error == rompack_not_a_pack && config->pack == NULL)
+    return read_rom_list(arg, config, NULL);
+  if (error != NULL) {
+    printf("%s: %s\n", path, error);
+    exit(EXIT_FAILURE);
+  }
+
+  return config->pack ? read_rom_list(arg, config, *pack)
+                      : read_rom_pack(*pack, config);
+}
+
+static double elapsed_seconds(struct timespec *start, struct timespec *end) {
+  return (double)(end->tv_sec - start->tv_sec) +
+         (double)(end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Loads and runs a single rom. Never exits, failures go to the record. */
+static void run_job(size_t index, void *ctx) {
+  BatchJob *job = &((BatchList *)ctx)->jobs[index];
+  const uint8_t *data = job->rom;
+  size_t size = job->rom_size;
+  struct timespec start, end;
+  RomData rd = {NULL, 0};
+  CHIP8 chip;
+
+  if (job->exit != NULL)
+    return;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  if (data == NULL) {
+    if ((job->error = load_rom_file(job->path, &rd)) != NULL) {
+      job->exit = "error";
+      return;
+    }
+    data = rd.data;
+    size = rd.size;
+  }
+
+  if (job->core == NULL)
+    job->core = chip_detect_core(data, size);
+
+  if (!chip_rom_fits(job->core, size)) {
+    free(rd.data);
+    job->exit = "error";
+    job->error = "rom does not fit into memory";
+    return;
+  }
+
+  chip = chip_init((ChipConfig){
+      .quirks = job->quirks, .seed = job->seed, .core = job->core});
+  if (chip == NULL) {
+    free(rd.data);
+    job->exit = "error";
+    job->error = "Failed to allocate memory";
+    return;
+  }
+
+  chip_load_rom(chip, data, size);
+  free(rd.data);
+
+  while ((job->frames == 0 || job->frames_run < job->frames) &&
+         (job->cycles == 0 || job->cycles_run < job->cycles) &&
+         chip_get_status(chip) == CHIP_RUNNING) {
+    uint32_t budget = job->cpf;
+
+    if (job->cycles && job->cycles - job->cycles_run < budget)
+      budget = (uint32_t)(job->cycles - job->cycles_run);
+
+    job->cycles_run += chip_run_cycles(chip, budget);
+    chip_update_timers(chip);
+    job->frames_run++;
+  }
+
+  job->exit = chip_get_status(chip) == CHIP_RUNNING
+                  ? "budget"
+                  : chip_status_name(chip_get_status(chip));
+  job->pc = chip_get_pc(chip);
+  job->vram_hash = hash_bytes(chip_get_vram_rows(chip),
+                              (size_t)chip_get_screen_width(chip) *
+                                  chip_get_screen_height(chip) *
+                                  chip_get_planes(chip) / 8);
+  chip_destroy(chip);
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  job->wall_time = elapsed_seconds(&start, &end);
+}
+
+static void write_csv_string(FILE *out, const char *value) {
+  fputc('"', out);
+  for (; *value; value++) {
+    if (*value == '"')
+      fputc('"', out);
+    fputc(*value, out);
+  }
+  fputc('"', out);
+}
+
+static void write_results(FILE *out, const BatchList *list) {
+  fprintf(out, "rom,exit,pc,cycles,frames,vram_hash,wall_ms,error\n");
+
+  for (size_t i = 0; i < list->count; i++) {
+    const BatchJob *job = &list->jobs[i];
+
+    write_csv_string(out, job->path);
+    fprintf(out, ",%s,%03X,%llu,%u,%016llx,%.3f,", job->exit, job->pc,
+            (unsigned long long)job->cycles_run, job->frames_run,
+            (unsigned long long)job->vram_hash, job->wall_time * 1e3);
+    if (job->error != NULL)
+      write_csv_string(out, job->error);
+    fputc('\n', out);
+  }
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2)
+    terminate("Usage: chipo8o-batch [LIST|PACK] [OPTION]...");
+
+  Config *config = parse_args_into_config(argc, argv);
+  ROMPACK pack = NULL;
+  BatchList list = read_jobs(argv[1], config, &pack);
+  unsigned threads = config->threads ? config->threads : pool_default_threads();
+  struct timespec start, end;
+  uint64_t cycles = 0;
+  FILE *out = stdout;
+
+  if (config->output != NULL && (out = fopen(config->output, "w")) == NULL) {
+    printf("Failed to open %s\n", config->output);
+    exit(EXIT_FAILURE);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  pool_run(list.count, threads, &run_job, &list);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  write_results(out, &list);
+
+  for (size_t i = 0; i < list.count; i++) {
+    cycles += list.jobs[i].cycles_run;
+    free(list.jobs[i].path);
+  }
+
+  double seconds = elapsed_seconds(&start, &end);
+  fprintf(stderr, "%zu roms, %u threads, %.3f s, %.0f cycles/sec\n", list.count,
+          threads, seconds, seconds > 0 ? cycles / seconds : 0.0);
+
+  if (out != stdout)
+    fclose(out);
+  free(list.jobs);
+  if (pack != NULL)
+    rompack_close(pack);
+  free(config);
+
+  return 0;
+}
@@ -0,0 +1,104 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "chip.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define WIDTH (SCREEN_WIDTH * 2)
+#define HEIGHT (SCREEN_HEIGHT * 2)
+#define ROUNDS 200000
+
+/*
+ * Microbenchmark for the Super-Chip scroll instructions. Times 00C1, 00FB
+ * and 00FC run by the core against the byte per pixel loops the core used
+ * before VRAM was packed. The core numbers include instruction dispatch.
+ */
+
+static uint8_t screen[WIDTH * HEIGHT];
+
+static void byte_scroll_down(int16_t rows) {
+  int16_t x, y;
+
+  for (x = 0; x < WIDTH; x++)
+    for (y = HEIGHT - 1; y >= 0; y--)
+      screen[y * WIDTH + x] = y < rows ? 0 : screen[(y - rows) * WIDTH + x];
+}
+
+static void byte_scroll_right(int16_t pixels) {
+  int16_t x, y;
+
+  for (x = WIDTH - 1; x >= 0; x--)
+    for (y = 0; y < HEIGHT; y++)
+      screen[y * WIDTH + x] = x < pixels ? 0 : screen[y * WIDTH + x - pixels];
+}
+
+static void byte_scroll_left(uint16_t pixels) {
+  uint16_t x, y;
+
+  for (x = 0; x < WIDTH; x++)
+    for (y = 0; y < HEIGHT; y++)
+      screen[y * WIDTH + x] =
+          x > WIDTH - 1 - pixels ? 0 : screen[y * WIDTH + x + pixels];
+}
+
+static double elapsed_seconds(struct timespec *start, struct timespec *end) {
+  return (double)(end->tv_sec - start->tv_sec) +
+         (double)(end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static double bench_bytes(bool hires) {
+  struct timespec start, end;
+
+  for (size_t i = 0; i < sizeof(screen); i++)
+    screen[i] = rand() & 1;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (uint32_t i = 0; i < ROUNDS; i++) {
+    byte_scroll_down(hires ? 1 : 2);
+    byte_scroll_right(hires ? 4 : 8);
+    byte_scroll_left(hires ? 4 : 8);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  return elapsed_seconds(&start, &end);
+}
+
+static double bench_core(bool hires) {
+  /* Sets the mode, then loops over 00C1, 00FB and 00FC. */
+  uint8_t rom[] = {0x00, 0xFE, 0x00, 0xC1, 0x00, 0xFB, 0x00, 0xFC, 0x12, 0x02};
+  struct timespec start, end;
+  CHIP8 chip =
+      chip_init((ChipConfig){.quirks = 0, .seed = 0, .core = &super_chip_core});
+
+  if (hires)
+    rom[1] = 0xFF;
+  if (chip == NULL)
+    terminate("Failed to allocate memory");
+  chip_load_rom(chip, rom, sizeof(rom));
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  chip_run_cycles(chip, 1 + 4 * ROUNDS);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  chip_destroy(chip);
+
+  return elapsed_seconds(&start, &end);
+}
+
+int main(void) {
+  printf("%-6s %14s %14s %8s\n", "mode", "bytes ns/op", "core ns/op",
+         "speedup");
+  for (int hires = 0; hires <= 1; hires++) {
+    double bytes = bench_bytes(hires);
+    double core = bench_core(hires);
+
+    printf("%-6s %14.1f %14.1f %7.1fx\n", hires ? "hires" : "lores",
+           bytes * 1e9 / (3.0 * ROUNDS), core * 1e9 / (3.0 * ROUNDS),
+           bytes / core);
+  }
+
+  return 0;
+}
@@ -0,0 +1,645 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "args.h"
+#include "chip.h"
+#include "config.h"
+#include "utils.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_REPS 10
+#define DEFAULT_WARMUP 2
+#define MICRO_UNROLL 32
+#define MICRO_CYCLES 2000000
+#define WORKLOAD_FRAMES 2000
+#define WORKLOAD_CPF 1000
+#define SCRATCH 0xE00
+#define UNIT_SIZE 3
+#define SETUP_SIZE 4
+#define MAX_LINE_SIZE 256
+
+/*
+ * Benchmark suite for the cores. The microbenchmarks run one handler, or a
+ * few that only make sense together, unrolled in a loop, so the numbers
+ * include dispatch and a share of the closing jump. The workloads are
+ * small generated roms run frame by frame like the headless runner does.
+ * Every benchmark is run warmup times untimed and then reps times, and
+ * reported as the mean nanoseconds per instruction with a 95% confidence
+ * interval.
+ */
+
+typedef struct {
+  uint8_t data[MEM_SIZE - START_ADDRESS];
+  size_t size;
+} BenchRom;
+
+/* An instruction of a unit; a target is added to the unit address as nnn. */
+typedef struct {
+  uint16_t opcode;
+  uint8_t target;
+} BenchOp;
+
+/* The first platform with a benchmark's instructions; later ones have them. */
+typedef enum { CHIP8_LEVEL, SUPER_CHIP_LEVEL, XO_CHIP_LEVEL } BenchLevel;
+
+typedef struct {
+  const char *name;
+  BenchLevel level;
+  uint16_t input;
+  uint16_t setup[SETUP_SIZE];
+  BenchOp unit[UNIT_SIZE];
+} MicroBench;
+
+typedef struct {
+  const char *name;
+  BenchLevel level;
+  void (*build)(BenchRom *);
+  /* The keypad is pressed on frames where frame % key_period is zero. */
+  uint32_t key_period;
+} Workload;
+
+typedef struct {
+  const char *backend;
+  const char *kind;
+  const char *name;
+  uint64_t instructions;
+  uint32_t reps;
+  double mean;
+  double ci;
+  double min;
+} BenchResult;
+
+typedef struct {
+  char backend[16];
+  char kind[16];
+  char name[32];
+  double mean;
+  double ci;
+} BaselineRow;
+
+typedef struct {
+  BaselineRow *rows;
+  size_t count;
+} Baseline;
+
+/*
+ * Skips are never taken, so every instruction of a unit runs. Registers
+ * start zeroed and I points at the font unless the setup says otherwise.
+ */
+static const MicroBench micro_benches[] = {
+    {"nop", CHIP8_LEVEL, 0, {0}, {{0x0123, 0}}},
+    {"00E0", CHIP8_LEVEL, 0, {0}, {{0x00E0, 0}}},
+    {"2nnn+00EE", CHIP8_LEVEL, 0, {0}, {{0x2000, 4}, {0x1000, 6}, {0x00EE, 0}}},
+    {"1xxx", CHIP8_LEVEL, 0, {0}, {{0x1000, 2}}},
+    {"3xkk", CHIP8_LEVEL, 0, {0}, {{0x3001, 0}}},
+    {"4xkk", CHIP8_LEVEL, 0, {0}, {{0x4000, 0}}},
+    {"5xy0", CHIP8_LEVEL, 0, {0x6101}, {{0x5010, 0}}},
+    {"6xkk", CHIP8_LEVEL, 0, {0}, {{0x6A55, 0}}},
+    {"7xkk", CHIP8_LEVEL, 0, {0}, {{0x7A01, 0}}},
+    {"8xy0", CHIP8_LEVEL, 0, {0}, {{0x8120, 0}}},
+    {"8xy1", CHIP8_LEVEL, 0, {0}, {{0x8121, 0}}},
+    {"8xy2", CHIP8_LEVEL, 0, {0}, {{0x8122, 0}}},
+    {"8xy3", CHIP8_LEVEL, 0, {0}, {{0x8123, 0}}},
+    {"8xy4", CHIP8_LEVEL, 0, {0x6107}, {{0x8124, 0}}},
+    {"8xy5", CHIP8_LEVEL, 0, {0x6107}, {{0x8125, 0}}},
+    {"8xy6", CHIP8_LEVEL, 0, {0x6107}, {{0x8126, 0}}},
+    {"8xy7", CHIP8_LEVEL, 0, {0x6107}, {{0x8127, 0}}},
+    {"8xyE", CHIP8_LEVEL, 0, {0x6107}, {{0x812E, 0}}},
+    {"9xy0", CHIP8_LEVEL, 0, {0}, {{0x9020, 0}}},
+    {"Annn", CHIP8_LEVEL, 0, {0}, {{0xAE00, 0}}},
+    {"Bnnn", CHIP8_LEVEL, 0, {0}, {{0xB000, 2}}},
+    {"Cxkk", CHIP8_LEVEL, 0, {0}, {{0xC0FF, 0}}},
+    {"Dxyn", CHIP8_LEVEL, 0, {0xF029}, {{0xD015, 0}}},
+    {"Ex9E", CHIP8_LEVEL, 0, {0}, {{0xE09E, 0}}},
+    {"ExA1", CHIP8_LEVEL, 1, {0}, {{0xE0A1, 0}}},
+    {"Fx07", CHIP8_LEVEL, 0, {0}, {{0xF007, 0}}},
+    {"Fx0A", CHIP8_LEVEL, 1, {0}, {{0xF00A, 0}}},
+    {"Fx15", CHIP8_LEVEL, 0, {0}, {{0xF015, 0}}},
+    {"Fx18", CHIP8_LEVEL, 0, {0}, {{0xF018, 0}}},
+    {"Fx1E", CHIP8_LEVEL, 0, {0}, {{0xF01E, 0}}},
+    {"Fx29", CHIP8_LEVEL, 0, {0}, {{0xF029, 0}}},
+    {"Fx33", CHIP8_LEVEL, 0, {0xAE00}, {{0xF033, 0}}},
+    {"Fx55", CHIP8_LEVEL, 0, {0xAE00}, {{0xFF55, 0}}},
+    {"Fx65", CHIP8_LEVEL, 0, {0xAE00}, {{0xFF65, 0}}},
+    {"00FF+00FE", SUPER_CHIP_LEVEL, 0, {0}, {{0x00FF, 0}, {0x00FE, 0}}},
+    {"00FB", SUPER_CHIP_LEVEL, 0, {0x00FF}, {{0x00FB, 0}}},
+    {"00FC", SUPER_CHIP_LEVEL, 0, {0x00FF}, {{0x00FC, 0}}},
+    {"00Cn", SUPER_CHIP_LEVEL, 0, {0x00FF}, {{0x00C1, 0}}},
+    {"Dxy0", SUPER_CHIP_LEVEL, 0, {0x00FF, 0xF030}, {{0xD010, 0}}},
+    {"Fx30", SUPER_CHIP_LEVEL, 0, {0}, {{0xF030, 0}}},
+    {"Fx75", SUPER_CHIP_LEVEL, 0, {0}, {{0xF775, 0}}},
+    {"Fx85", SUPER_CHIP_LEVEL, 0, {0}, {{0xF785, 0}}},
+    {"F002", SUPER_CHIP_LEVEL, 0, {0xAE00}, {{0xF002, 0}}},
+    {"Fx3A", SUPER_CHIP_LEVEL, 0, {0}, {{0xF03A, 0}}},
+    {"00Dn", XO_CHIP_LEVEL, 0, {0x00FF}, {{0x00D1, 0}}},
+    {"5xy2", XO_CHIP_LEVEL, 0, {0xAE00}, {{0x50F2, 0}}},
+    {"5xy3", XO_CHIP_LEVEL, 0, {0xAE00}, {{0x50F3, 0}}},
+    {"F000", XO_CHIP_LEVEL, 0, {0}, {{0xF000, 0}, {0xE000, 0}}},
+    {"Fn01", XO_CHIP_LEVEL, 0, {0}, {{0xF301, 0}}},
+    {"Dxyn-both", XO_CHIP_LEVEL, 0, {0xF301, 0xF029}, {{0xD015, 0}}},
+};
+
+/* Two sided 95% quantiles of Student's t for 1 to 30 degrees of freedom. */
+static const double t95[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447,
+                             2.365,  2.306, 2.262, 2.228, 2.201, 2.179,
+                             2.160,  2.145, 2.131, 2.120, 2.110, 2.101,
+                             2.093,  2.086, 2.080, 2.074, 2.069, 2.064,
+                             2.060,  2.056, 2.052, 2.048, 2.045, 2.042};
+
+static uint16_t rom_here(const BenchRom *rom) {
+  return START_ADDRESS + rom->size;
+}
+
+static void rom_emit(BenchRom *rom, uint16_t opcode) {
+  if (rom->size + 2 > sizeof(rom->data))
+    terminate("Benchmark rom does not fit into memory");
+
+  rom->data[rom->size++] = opcode >> 8;
+  rom->data[rom->size++] = opcode & 0xFF;
+}
+
+static void build_micro(BenchRom *rom, const MicroBench *mb) {
+  uint16_t loop;
+
+  for (size_t i = 0; i < SETUP_SIZE && mb->setup[i]; i++)
+    rom_emit(rom, mb->setup[i]);
+
+  loop = rom_here(rom);
+  for (uint32_t n = 0; n < MICRO_UNROLL; n++) {
+    uint16_t unit = rom_here(rom);
+
+    for (size_t i = 0; i < UNIT_SIZE && mb->unit[i].opcode; i++)
+      rom_emit(rom, mb->unit[i].opcode |
+                        (mb->unit[i].target ? unit + mb->unit[i].target : 0));
+  }
+  rom_emit(rom, 0x1000 | loop);
+}
+
+/* Mixed arithmetic and skips on registers only. */
+static void build_alu(BenchRom *rom) {
+  uint16_t loop;
+
+  rom_emit(rom, 0x6001);
+  rom_emit(rom, 0x6103);
+  loop = rom_here(rom);
+  rom_emit(rom, 0x7001);
+  rom_emit(rom, 0x8204);
+  rom_emit(rom, 0x8315);
+  rom_emit(rom, 0x8432);
+  rom_emit(rom, 0x8541);
+  rom_emit(rom, 0x8653);
+  rom_emit(rom, 0x8706);
+  rom_emit(rom, 0x881E);
+  rom_emit(rom, 0x8927);
+  rom_emit(rom, 0x3A00);
+  rom_emit(rom, 0x7A01);
+  rom_emit(rom, 0x4B01);
+  rom_emit(rom, 0x7B02);
+  rom_emit(rom, 0x9010);
+  rom_emit(rom, 0x71FF);
+  rom_emit(rom, 0x1000 | loop);
+}
+
+/* Font digits drawn all over the screen, wrapping at the edges. */
+static void build_sprites(BenchRom *rom) {
+  uint16_t loop = rom_here(rom);
+
+  rom_emit(rom, 0xF229);
+  rom_emit(rom, 0xD015);
+  rom_emit(rom, 0x7005);
+  rom_emit(rom, 0xD105);
+  rom_emit(rom, 0x7103);
+  rom_emit(rom, 0xD015);
+  rom_emit(rom, 0x7201);
+  rom_emit(rom, 0x7309);
+  rom_emit(rom, 0xD235);
+  rom_emit(rom, 0x1000 | loop);
+}
+
+/* Super-Chip hires scrolls in every direction between 16x16 sprites. */
+static void build_scroll(BenchRom *rom) {
+  uint16_t loop;
+
+  rom_emit(rom, 0x00FF);
+  rom_emit(rom, 0xF030);
+  loop = rom_here(rom);
+  rom_emit(rom, 0xD010);
+  rom_emit(rom, 0x00C1);
+  rom_emit(rom, 0x00FB);
+  rom_emit(rom, 0x7011);
+  rom_emit(rom, 0x00C4);
+  rom_emit(rom, 0x00FC);
+  rom_emit(rom, 0x7107);
+  rom_emit(rom, 0x1000 | loop);
+}
+
+/* XO-CHIP hires sprites on both planes, scrolled down and up. */
+static void build_planes(BenchRom *rom) {
+  uint16_t loop;
+
+  rom_emit(rom, 0x00FF);
+  rom_emit(rom, 0xF301);
+  loop = rom_here(rom);
+  rom_emit(rom, 0xF229);
+  rom_emit(rom, 0xD015);
+  rom_emit(rom, 0x7005);
+  rom_emit(rom, 0x00D1);
+  rom_emit(rom, 0xD105);
+  rom_emit(rom, 0x7103);
+  rom_emit(rom, 0x00C2);
+  rom_emit(rom, 0x7201);
+  rom_emit(rom, 0x1000 | loop);
+}
+
+/* Register file stores and loads, BCD and I arithmetic on a data area. */
+static void build_memory(BenchRom *rom) {
+  uint16_t loop = rom_here(rom);
+
+  rom_emit(rom, 0xA000 | SCRATCH);
+  rom_emit(rom, 0xFF55);
+  rom_emit(rom, 0xF01E);
+  rom_emit(rom, 0xF333);
+  rom_emit(rom, 0xF765);
+  rom_emit(rom, 0x7011);
+  rom_emit(rom, 0xA000 | (SCRATCH + 0x80));
+  rom_emit(rom, 0xFF65);
+  rom_emit(rom, 0xF855);
+  rom_emit(rom, 0x1000 | loop);
+}
+
+/* Waits for a key, draws it and waits for the next one. */
+static void build_keys(BenchRom *rom) {
+  uint16_t loop = rom_here(rom);
+
+  rom_emit(rom, 0xF20A);
+  rom_emit(rom, 0xF229);
+  rom_emit(rom, 0xD015);
+  rom_emit(rom, 0x7004);
+  rom_emit(rom, 0x1000 | loop);
+}
+
+static const Workload workloads[] = {
+    {"alu", CHIP8_LEVEL, &build_alu, 0},
+    {"sprites", CHIP8_LEVEL, &build_sprites, 0},
+    {"scroll", SUPER_CHIP_LEVEL, &build_scroll, 0},
+    {"planes", XO_CHIP_LEVEL, &build_planes, 0},
+    {"memory", CHIP8_LEVEL, &build_memory, 0},
+    {"keys", CHIP8_LEVEL, &build_keys, 4},
+};
+
+Config *parse_args_into_config(int argc, char **argv) {
+  Config *config = config_init();
+
+  ArgParserOptions *options = args_init_options(8);
+  args_add_options(
+      options, 8,
+      (ArgParserOption){.lng = "reps",
+                        .shrt = 'r',
+                        .description = "timed repetitions of every benchmark. "
+                                       "Default: 10",
+                        .parse = &parse_uint_arg_value,
+                        .set = &config_set_reps},
+      (ArgParserOption){.lng = "warmup",
+                        .shrt = 'w',
+                        .description = "untimed runs before the repetitions. "
+                                       "Default: 2",
+                        .parse = &parse_uint_arg_value,
+                        .set = &config_set_warmup},
+      (ArgParserOption){.lng = "output",
+                        .shrt = 'o',
+                        .description = "write the results as CSV to a file",
+                        .parse = &parse_string_arg_value,
+                        .set = &config_set_output},
+      (ArgParserOption){.lng = "baseline",
+                        .shrt = 'b',
+                        .description = "compare with the CSV of an earlier "
+                                       "run",
+                        .parse = &parse_string_arg_value,
+                        .set = &config_set_baseline},
+      (ArgParserOption){.lng = "core",
+                        .shrt = 'k',
+                        .description = "only benchmark one core: chip-8, "
+                                       "super-chip or xo-chip. Default: all",
+                        .parse = &parse_core_arg_value,
+                        .set = &config_set_core},
+      (ArgParserOption){.lng = "quirk",
+                        .shrt = 'q',
+                        .description = "enable a quirk, same values as for "
+                                       "chipo8o. Can be used multiple times",
+                        .parse = &parse_chip_quirk_arg_value,
+                        .set = &config_set_chip_quirks},
+      (ArgParserOption){.lng = "roms",
+                        .shrt = 'd',
+                        .description = "also write the workload roms to an "
+                                       "existing directory",
+                        .parse = &parse_string_arg_value,
+                        .set = &config_set_rom_dir},
+      (ArgParserOption){.lng = "help",
+                        .shrt = 'h',
+                        .description = "display this help and exit",
+                        .parse = &display_help_message,
+                        .set = NULL});
+
+  args_parse(options, argc, argv, config);
+  args_destroy(options);
+
+  return config;
+}
+
+static double elapsed_seconds(struct timespec *start, struct timespec *end) {
+  return (double)(end->tv_sec - start->tv_sec) +
+         (double)(end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static CHIP8 load_chip(ChipConfig conf, const BenchRom *rom, uint16_t input) {
+  CHIP8 chip = chip_init(conf);
+
+  if (chip == NULL)
+    terminate("Failed to allocate memory");
+  chip_load_rom(chip, rom->data, rom->size);
+  chip_update_input(chip, input, 0);
+
+  return chip;
+}
+
+static void check_running(CHIP8 chip, const char *name) {
+  if (chip_get_status(chip) != CHIP_RUNNING) {
+    fprintf(stderr, "Benchmark %s stopped: %s\n", name,
+            chip_status_name(chip_get_status(chip)));
+    exit(EXIT_FAILURE);
+  }
+}
+
+/* Returns the nanoseconds per instruction of one run of a microbenchmark. */
+static double run_micro(ChipConfig conf, const MicroBench *mb,
+                        const BenchRom *rom) {
+  CHIP8 chip = load_chip(conf, rom, mb->input);
+  struct timespec start, end;
+  uint32_t cycles;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  cycles = chip_run_cycles(chip, MICRO_CYCLES);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  check_running(chip, mb->name);
+  chip_destroy(chip);
+
+  return elapsed_seconds(&start, &end) * 1e9 / cycles;
+}
+
+/* Same for a workload, including the timers and input of every frame. */
+static double run_workload(ChipConfig conf, const Workload *wl,
+                           const BenchRom *rom) {
+  CHIP8 chip = load_chip(conf, rom, 0);
+  ChipSoundEvent events[SOUND_EVENTS];
+  struct timespec start, end;
+  uint64_t cycles = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (uint32_t frame = 0; frame < WORKLOAD_FRAMES; frame++) {
+    if (wl->key_period) {
+      bool down = frame % wl->key_period == 0;
+      chip_update_input(chip, down ? 1 << (frame & 0xF) : 0, frame & 0xF);
+    }
+    cycles += chip_run_cycles(chip, WORKLOAD_CPF);
+    chip_update_timers(chip);
+    chip_take_sound_events(chip, events);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  check_running(chip, wl->name);
+  chip_destroy(chip);
+
+  return elapsed_seconds(&start, &end) * 1e9 / cycles;
+}
+
+static void summarize(BenchResult *result, const double *samples) {
+  double sum = 0, squares = 0;
+  uint32_t n = result->reps;
+
+  result->min = samples[0];
+  for (uint32_t i = 0; i < n; i++) {
+    sum += samples[i];
+    if (samples[i] < result->min)
+      result->min = samples[i];
+  }
+  result->mean = sum / n;
+
+  for (uint32_t i = 0; i < n; i++)
+    squares += (samples[i] - result->mean) * (samples[i] - result->mean);
+  result->ci = 0;
+  if (n > 1)
+    result->ci = (n - 1 <= 30 ? t95[n - 2] : 1.96) *
+                 sqrt(squares / (n - 1)) / sqrt(n);
+}
+
+static const char *read_field(char **line) {
+  char *field = *line, *end = strchr(field, ',');
+
+  if (end != NULL) {
+    *end = '\0';
+    *line = end + 1;
+  } else {
+    *line = field + strlen(field);
+  }
+  return field;
+}
+
+/* Reads the rows of an earlier run. */
+static Baseline read_baseline(const char *path) {
+  Baseline baseline = {.rows = NULL, .count = 0};
+  char line[MAX_LINE_SIZE];
+  size_t capacity = 0;
+  FILE *fp = fopen(path, "r");
+
+  if (fp == NULL) {
+    printf("WARNING: failed to open the baseline %s\n", path);
+    return baseline;
+  }
+
+  while (fgets(line, sizeof(line), fp)) {
+    char *rest = line;
+    const char *backend = read_field(&rest), *kind = read_field(&rest),
+               *name = read_field(&rest);
+    BaselineRow *row;
+
+    if (baseline.count == capacity) {
+      capacity = capacity ? capacity * 2 : 64;
+      row = realloc(baseline.rows, capacity * sizeof(BaselineRow));
+      if (row == NULL)
+        terminate("Failed to allocate memory");
+      baseline.rows = row;
+    }
+
+    row = &baseline.rows[baseline.count];
+    snprintf(row->backend, sizeof(row->backend), "%s", backend);
+    snprintf(row->kind, sizeof(row->kind), "%s", kind);
+    snprintf(row->name, sizeof(row->name), "%s", name);
+    /* Skips the instructions and reps columns. */
+    read_field(&rest);
+    read_field(&rest);
+    row->mean = strtod(read_field(&rest), NULL);
+    row->ci = strtod(read_field(&rest), NULL);
+    if (row->mean > 0)
+      baseline.count++;
+  }
+
+  fclose(fp);
+  return baseline;
+}
+
+static const BaselineRow *find_baseline(const Baseline *baseline,
+                                        const BenchResult *result) {
+  for (size_t i = 0; i < baseline->count; i++)
+    if (strcmp(baseline->rows[i].backend, result->backend) == 0 &&
+        strcmp(baseline->rows[i].kind, result->kind) == 0 &&
+        strcmp(baseline->rows[i].name, result->name) == 0)
+      return &baseline->rows[i];
+  return NULL;
+}
+
+/*
+ * Prints a result, compared with the baseline when it has one. A change
+ * counts only when the two confidence intervals don't overlap.
+ */
+static void print_result(const BenchResult *result, const Baseline *baseline) {
+  const BaselineRow *base = find_baseline(baseline, result);
+
+  printf("%-8s %-10s %9.2f +- %5.2f", result->kind, result->name,
+         result->mean, result->ci);
+  if (base != NULL) {
+    double change = 100.0 * (result->mean - base->mean) / base->mean;
+    bool moved = fabs(result->mean - base->mean) > result->ci + base->ci;
+
+    printf(" %9.2f %+7.1f%%", base->mean, change);
+    if (moved)
+      printf(" %s", change < 0 ? "faster" : "slower");
+  }
+  printf("\n");
+}
+
+static void write_result(FILE *out, const BenchResult *result) {
+  fprintf(out, "%s,%s,%s,%llu,%u,%.4f,%.4f,%.4f\n", result->backend,
+          result->kind, result->name,
+          (unsigned long long)result->instructions, result->reps,
+          result->mean, result->ci, result->min);
+}
+
+static void write_rom(const char *dir, const char *name, const BenchRom *rom) {
+  char path[FILENAME_MAX];
+  FILE *fp;
+
+  snprintf(path, sizeof(path), "%s/%s.ch8", dir, name);
+  fp = fopen(path, "wb");
+  if (fp == NULL || fwrite(rom->data, 1, rom->size, fp) != rom->size)
+    printf("WARNING: failed to write %s\n", path);
+  if (fp != NULL)
+    fclose(fp);
+}
+
+/* Runs every benchmark the core supports. */
+static void bench_core(const ChipCore *core, const Config *config,
+                       const Baseline *baseline, FILE *out, double *samples) {
+  ChipConfig conf = {.quirks = config->chip_quirks, .seed = 0, .core = core};
+  BenchLevel level = core == &xo_chip_core      ? XO_CHIP_LEVEL
+                     : core == &super_chip_core ? SUPER_CHIP_LEVEL
+                                                : CHIP8_LEVEL;
+  uint32_t reps = config->reps ? config->reps : DEFAULT_REPS;
+  uint32_t warmup = config->warmup_set ? config->warmup : DEFAULT_WARMUP;
+
+  printf("%s, %u reps after %u warmup, quirks %02X, ns/instruction\n",
+         core->name, reps, warmup, config->chip_quirks);
+  printf("%-8s %-10s %18s", "kind", "name", "mean +- ci95");
+  if (baseline->count)
+    printf(" %9s %8s", "baseline", "change");
+  printf("\n");
+
+  for (size_t i = 0; i < sizeof(micro_benches) / sizeof(MicroBench); i++) {
+    const MicroBench *mb = &micro_benches[i];
+    BenchResult result = {
+        .backend = core->name, .kind = "micro", .name = mb->name, .reps = reps};
+    BenchRom rom = {.size = 0};
+
+    if (mb->level > level)
+      continue;
+
+    build_micro(&rom, mb);
+    for (uint32_t r = 0; r < warmup; r++)
+      run_micro(conf, mb, &rom);
+    for (uint32_t r = 0; r < reps; r++)
+      samples[r] = run_micro(conf, mb, &rom);
+
+    result.instructions = MICRO_CYCLES;
+    summarize(&result, samples);
+    print_result(&result, baseline);
+    if (out != NULL)
+      write_result(out, &result);
+  }
+
+  for (size_t i = 0; i < sizeof(workloads) / sizeof(Workload); i++) {
+    const Workload *wl = &workloads[i];
+    BenchResult result = {.backend = core->name,
+                          .kind = "workload",
+                          .name = wl->name,
+                          .reps = reps};
+    BenchRom rom = {.size = 0};
+
+    if (wl->level > level)
+      continue;
+
+    wl->build(&rom);
+    if (config->rom_dir != NULL)
+      write_rom(config->rom_dir, wl->name, &rom);
+    for (uint32_t r = 0; r < warmup; r++)
+      run_workload(conf, wl, &rom);
+    for (uint32_t r = 0; r < reps; r++)
+      samples[r] = run_workload(conf, wl, &rom);
+
+    result.instructions = (uint64_t)WORKLOAD_FRAMES * WORKLOAD_CPF;
+    summarize(&result, samples);
+    print_result(&result, baseline);
+    if (out != NULL)
+      write_result(out, &result);
+  }
+}
+
+int main(int argc, char **argv) {
+  Config *config = parse_args_into_config(argc, argv);
+  uint32_t reps = config->reps ? config->reps : DEFAULT_REPS;
+  Baseline baseline = {.rows = NULL, .count = 0};
+  double *samples = malloc(reps * sizeof(double));
+  FILE *out = NULL;
+
+  if (samples == NULL)
+    terminate("Failed to allocate memory");
+  if (config->baseline != NULL)
+    baseline = read_baseline(config->baseline);
+  if (config->output != NULL && (out = fopen(config->output, "w")) == NULL) {
+    printf("Failed to open %s\n", config->output);
+    exit(EXIT_FAILURE);
+  }
+  if (out != NULL)
+    fprintf(out, "backend,kind,name,instructions,reps,mean_ns,ci95_ns,"
+                 "min_ns\n");
+
+  if (config->core != NULL) {
+    bench_core(config->core, config, &baseline, out, samples);
+  } else {
+    bench_core(&chip8_core, config, &baseline, out, samples);
+    printf("\n");
+    bench_core(&super_chip_core, config, &baseline, out, samples);
+    printf("\n");
+    bench_core(&xo_chip_core, config, &baseline, out, samples);
+  }
+
+  if (out != NULL)
+    fclose(out);
+  free(baseline.rows);
+  free(samples);
+  free(config);
+
+  return 0;
+}
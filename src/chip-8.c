@@ -0,0 +1,4 @@
+#define CORE_TABLE chip8_core
+#define CORE_OPTABLE "optable-chip-8.h"
+
+#include "chip-core.h"
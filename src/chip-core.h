@@ -0,0 +1,1740 @@
+/*
+ * The core of a machine, included once per platform: by chip-8.c for the
+ * CHIP-8, by super-chip.c, with CHIP_SUPER_CHIP defined, for the Super-Chip
+ * and by xo-chip.c, with CHIP_XO_CHIP defined as well, for the XO-CHIP.
+ * Each defines CORE_TABLE, the name of its ChipCore, and CORE_OPTABLE, its
+ * generated opcode table. The screen geometry, memory size and number of
+ * bit planes are constants of the platform, so the masks and strides of
+ * the screen code fold into the handlers of each.
+ */
+#include "chip.h"
+#include "opcodes.h"
+#include "rng.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef CHIP_SUPER_CHIP
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#elif defined(CHIP_JIT)
+#define CORE_JIT
+#include "jit-x64.h"
+#include <stddef.h>
+#endif
+
+#ifdef CHIP_SUPER_CHIP
+#ifdef CHIP_XO_CHIP
+#define CORE_NAME "xo-chip"
+#define CORE_MEM_SIZE XO_MEM_SIZE
+#define CORE_PLANES 2
+#else
+#define CORE_NAME "super-chip"
+#define CORE_MEM_SIZE MEM_SIZE
+#define CORE_PLANES 1
+#endif
+#define CORE_WIDTH (SCREEN_WIDTH * 2)
+#define CORE_HEIGHT (SCREEN_HEIGHT * 2)
+#define STACK_SIZE 16
+#define WIDE_SPRITE_SIZE 16
+#define WIDE_FONTS_START_ADDRESS 80
+#define LEFT_PIXELS 0xAAAAAAAAAAAAAAAAull
+
+static const uint8_t wide_font[100] = {
+    0x3C, 0x7E, 0xE7, 0xC3, 0xC3, 0xC3, 0xC3, 0xE7, 0x7E, 0x3C, // 0
+    0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, // 1
+    0x3E, 0x7F, 0xC3, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xFF, 0xFF, // 2
+    0x3C, 0x7E, 0xC3, 0x03, 0x0E, 0x0E, 0x03, 0xC3, 0x7E, 0x3C, // 3
+    0x06, 0x0E, 0x1E, 0x36, 0x66, 0xC6, 0xFF, 0xFF, 0x06, 0x06, // 4
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFE, 0x03, 0xC3, 0x7E, 0x3C, // 5
+    0x3E, 0x7C, 0xC0, 0xC0, 0xFC, 0xFE, 0xC3, 0xC3, 0x7E, 0x3C, // 6
+    0xFF, 0xFF, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x60, 0x60, // 7
+    0x3C, 0x7E, 0xC3, 0xC3, 0x7E, 0x7E, 0xC3, 0xC3, 0x7E, 0x3C, // 8
+    0x3C, 0x7E, 0xC3, 0xC3, 0x7F, 0x3F, 0x03, 0x03, 0x3E, 0x7C  // 9
+};
+#else
+#define CORE_NAME "chip-8"
+#define CORE_MEM_SIZE MEM_SIZE
+#define CORE_PLANES 1
+#define CORE_WIDTH SCREEN_WIDTH
+#define CORE_HEIGHT SCREEN_HEIGHT
+#define STACK_SIZE 12
+#endif
+
+#define ROW_WORDS (CORE_WIDTH / VRAM_WORD_BITS)
+#define CORE_VRAM_SIZE (ROW_WORDS * CORE_HEIGHT)
+#define ALL_ROWS (~0ull >> (64 - CORE_HEIGHT))
+
+/*
+ * The planes drawing, scrolling and clearing apply to, bit n being plane n.
+ * Only the XO-CHIP can select them, the others always have the one.
+ */
+#ifdef CHIP_XO_CHIP
+#define SELECTED_PLANES(chip) ((chip)->planes)
+#else
+#define SELECTED_PLANES(chip) 1
+#endif
+
+/*
+ * Handlers specialized for the quirks they check, with the quirks as
+ * constants. bind_quirks maps every op to the variant a machine runs with,
+ * so the decoder and the threaded dispatch never test a quirk bit.
+ */
+#define CHIP8_QUIRK_OPS(X)                                                     \
+  X(8xy1, vfreset)                                                             \
+  X(8xy2, vfreset)                                                             \
+  X(8xy3, vfreset)                                                             \
+  X(8xy6, shifting)                                                            \
+  X(8xyE, shifting)                                                            \
+  X(Bnnn, jumping)                                                             \
+  X(Fx55, memory)                                                              \
+  X(Fx65, memory)                                                              \
+  X(Dxyn, clipping)                                                            \
+  X(Dxyn, display)                                                             \
+  X(Dxyn, display_clipping)
+
+#ifdef CHIP_SUPER_CHIP
+#define CORE_QUIRK_OPS(X)                                                      \
+  CHIP8_QUIRK_OPS(X)                                                           \
+  X(Dxy0, clipping)                                                            \
+  X(Dxy0, display)                                                             \
+  X(Dxy0, display_clipping)
+#else
+#define CORE_QUIRK_OPS(X) CHIP8_QUIRK_OPS(X)
+#endif
+
+#define QUIRK_OP_ENUM(name, quirk) OP_##name##_##quirk,
+enum {
+  OP_QUIRK_BASE = OP_COUNT - 1,
+  CORE_QUIRK_OPS(QUIRK_OP_ENUM) OP_BOUND_COUNT
+};
+#undef QUIRK_OP_ENUM
+
+typedef struct Instr {
+  void (*exec)(CHIP8, const struct Instr *);
+  uint16_t opcode;
+  uint16_t nnn;
+  uint8_t x;
+  uint8_t y;
+  uint8_t kk;
+  uint8_t n;
+} Instr;
+
+#ifdef CORE_JIT
+#define JIT_CODE_SIZE (1 << 20)
+#define JIT_BLOCK_MAX 64
+#define JIT_HOT_THRESHOLD 32
+
+typedef uint32_t (*JitBlockFn)(CHIP8);
+typedef struct JitBlock {
+  JitBlockFn code;
+  uint16_t count;
+  uint16_t size;
+  uint16_t hotness;
+} JitBlock;
+#endif
+
+/* The machine starts with its core, which chip.c dispatches through. */
+struct chip8 {
+  const ChipCore *core;
+  uint16_t pc;
+  uint8_t *mem;
+  uint32_t vram_generation;
+  uint64_t dirty_rows;
+  uint16_t stack[STACK_SIZE];
+
+  uint16_t index;
+  uint8_t dt;
+  uint8_t st;
+  uint8_t sp;
+  uint8_t regs[REGS_COUNT];
+
+  uint16_t input;
+  uint8_t input_key;
+
+  Instr *icache;
+  uint32_t icache_end;
+#ifdef CORE_JIT
+  JitBlock *blocks;
+  uint8_t *translated;
+  JitBuffer *jit;
+#endif
+
+  uint8_t quirks;
+  uint8_t ops[OP_COUNT];
+#ifdef CHIP_THREADED
+  void *labels[OP_COUNT];
+  bool labels_bound;
+#endif
+  ChipStatus status;
+  bool vblank;
+  uint64_t cycle;
+  ChipSoundEvent sound_events[SOUND_EVENTS];
+  uint8_t sound_event_count;
+  ChipRng rng;
+  uint64_t vram[CORE_PLANES * CORE_VRAM_SIZE];
+#ifdef CHIP_SUPER_CHIP
+  bool hires_mode_enabled;
+  ChipAudio audio;
+#endif
+#ifdef CHIP_XO_CHIP
+  uint8_t planes;
+#endif
+#ifdef CHIP_PROFILE
+  ChipProfile profile;
+  uint64_t profile_base[MEM_SIZE];
+  uint8_t profile_op[MEM_SIZE];
+#endif
+};
+
+static void decode(CHIP8, Instr *, uint16_t);
+static void invalidate(CHIP8, uint16_t, size_t);
+static void invalidate_all(CHIP8);
+static void bind_quirks(CHIP8);
+#ifndef CHIP_THREADED
+static Instr *fetch(CHIP8);
+static void execute(CHIP8, const Instr *);
+#endif
+
+/*
+ * Profile builds count every instruction by address at fetch, and the
+ * memory touched by sprites and register loads and stores. Handler counts
+ * are settled from the address counts when an address is decoded again or
+ * the profile is read, which keeps them off the dispatch path. Otherwise
+ * the counters vanish. The counters cover the first MEM_SIZE bytes, which
+ * on the XO-CHIP leaves out the code and data of the larger roms.
+ */
+#ifdef CHIP_PROFILE
+#if CORE_MEM_SIZE > MEM_SIZE
+#define PROFILED(addr) ((addr) < MEM_SIZE)
+#else
+#define PROFILED(addr) true
+#endif
+#define PROFILE_EXEC(chip, addr)                                               \
+  do {                                                                         \
+    if (PROFILED(addr))                                                        \
+      (chip)->profile.pcs[addr]++;                                             \
+  } while (0)
+#define PROFILE_DECODE(chip, addr, op) profile_decode(chip, addr, op)
+#define PROFILE_READS(chip, addr, size)                                        \
+  profile_range((chip)->profile.reads, addr, size)
+#define PROFILE_WRITES(chip, addr, size)                                       \
+  profile_range((chip)->profile.writes, addr, size)
+
+#define OP_NAME(name) #name,
+static const char *const op_names[OP_COUNT] = {CHIP_OPS(OP_NAME)};
+#undef OP_NAME
+
+/* Credits the runs since the last decode of addr to the handler it had. */
+static void profile_settle(CHIP8 chip, uint16_t addr) {
+  chip->profile.ops[chip->profile_op[addr]] +=
+      chip->profile.pcs[addr] - chip->profile_base[addr];
+  chip->profile_base[addr] = chip->profile.pcs[addr];
+}
+
+static void profile_decode(CHIP8 chip, uint16_t addr, ChipOp op) {
+  if (!PROFILED(addr))
+    return;
+  profile_settle(chip, addr);
+  chip->profile_op[addr] = op;
+}
+
+static void profile_range(uint64_t *counts, uint16_t addr, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    size_t at = (addr + i) & (CORE_MEM_SIZE - 1);
+
+    if (PROFILED(at))
+      counts[at]++;
+  }
+}
+#else
+#define PROFILE_EXEC(chip, addr)
+#define PROFILE_DECODE(chip, addr, op)
+#define PROFILE_READS(chip, addr, size)
+#define PROFILE_WRITES(chip, addr, size)
+#endif
+
+#ifdef CORE_JIT
+static void jit_invalidate(CHIP8, uint16_t, size_t);
+#endif
+
+static void core_destroy(CHIP8);
+
+static CHIP8 core_init(ChipConfig conf) {
+  CHIP8 chip = calloc(1, sizeof(struct chip8));
+
+  if (chip == NULL)
+    return NULL;
+
+  /* Pages of memory and cache a rom never touches are never mapped. */
+  chip->mem = calloc(CORE_MEM_SIZE, sizeof(uint8_t));
+  if (chip->mem == NULL) {
+    core_destroy(chip);
+    return NULL;
+  }
+
+  chip->icache = calloc(CORE_MEM_SIZE, sizeof(Instr));
+  if (chip->icache == NULL) {
+    core_destroy(chip);
+    return NULL;
+  }
+
+#ifdef CORE_JIT
+  chip->blocks = calloc(MEM_SIZE, sizeof(JitBlock));
+  chip->translated = calloc(MEM_SIZE, sizeof(uint8_t));
+  chip->jit = jit_buffer_init(JIT_CODE_SIZE);
+  if (chip->blocks == NULL || chip->translated == NULL || chip->jit == NULL) {
+    core_destroy(chip);
+    return NULL;
+  }
+#endif
+
+  chip->core = &CORE_TABLE;
+  chip->pc = START_ADDRESS;
+  chip->index = 0;
+  chip->dt = 0;
+  chip->st = 0;
+  chip->sp = 0;
+  chip->input = 0;
+  chip->input_key = 0;
+  chip->quirks = conf.quirks;
+  bind_quirks(chip);
+  chip->status = CHIP_RUNNING;
+  rng_seed(&chip->rng, conf.seed);
+#ifdef CHIP_SUPER_CHIP
+  chip->hires_mode_enabled = false;
+  chip->audio.pitch = AUDIO_DEFAULT_PITCH;
+#endif
+#ifdef CHIP_XO_CHIP
+  chip->planes = 1;
+#endif
+#ifdef CHIP_PROFILE
+  chip->profile.op_names = op_names;
+  chip->profile.op_count = OP_COUNT;
+#endif
+
+  uint8_t i;
+  for (i = 0; i < REGS_COUNT; i++) {
+    chip->regs[i] = 0;
+  }
+  for (i = 0; i < STACK_SIZE; i++) {
+    chip->stack[i] = 0;
+  }
+  for (i = 0; i < 80; i++) {
+    chip->mem[i] = font[i];
+  }
+#ifdef CHIP_SUPER_CHIP
+  for (i = 0; i < 100; i++) {
+    chip->mem[WIDE_FONTS_START_ADDRESS + i] = wide_font[i];
+  }
+#endif
+
+  return chip;
+}
+
+static void core_destroy(CHIP8 chip) {
+  free(chip->mem);
+  free(chip->icache);
+#ifdef CORE_JIT
+  free(chip->blocks);
+  free(chip->translated);
+  if (chip->jit != NULL)
+    jit_buffer_destroy(chip->jit);
+#endif
+  free(chip);
+}
+
+#if !defined(CHIP_THREADED) && !defined(CORE_JIT)
+static uint32_t core_run_cycles(CHIP8 chip, uint32_t cycles) {
+  uint32_t done = 0;
+
+  while (done < cycles && chip->status == CHIP_RUNNING) {
+    chip->cycle++;
+    execute(chip, fetch(chip));
+    done++;
+  }
+
+  return done;
+}
+#endif
+
+static void core_update_input(CHIP8 chip, uint16_t input, uint8_t key) {
+  chip->input = input;
+  chip->input_key = key;
+}
+
+static uint16_t core_get_input(CHIP8 chip) { return chip->input; }
+
+static uint8_t core_get_input_key(CHIP8 chip) { return chip->input_key; }
+
+static void core_load_rom(CHIP8 chip, const uint8_t *rom, size_t size) {
+  memcpy(&chip->mem[START_ADDRESS], rom, size);
+  invalidate(chip, START_ADDRESS, size);
+}
+
+static const uint64_t *core_get_vram_rows(CHIP8 chip) { return chip->vram; }
+
+static uint32_t core_get_vram_generation(CHIP8 chip) {
+  return chip->vram_generation;
+}
+
+/* Returns the rows changed since the last call, bit n being row n. */
+static uint64_t core_take_dirty_rows(CHIP8 chip) {
+  uint64_t rows = chip->dirty_rows;
+
+  chip->dirty_rows = 0;
+  return rows;
+}
+
+static void core_get_frame(CHIP8 chip, ChipFrame *frame) {
+  memcpy(frame->vram, chip->vram, sizeof(chip->vram));
+  frame->screen_width = CORE_WIDTH;
+  frame->screen_height = CORE_HEIGHT;
+  frame->planes = CORE_PLANES;
+  frame->vram_generation = chip->vram_generation;
+  frame->dirty_rows = core_take_dirty_rows(chip);
+}
+
+/* Records a change to the frame for the renderer. */
+static void touch_rows(CHIP8 chip, uint64_t rows) {
+  chip->dirty_rows |= rows;
+  chip->vram_generation++;
+}
+
+/* The rows of plane p, or NULL if it isn't selected. */
+static inline uint64_t *selected_plane(CHIP8 chip, uint8_t p) {
+  return SELECTED_PLANES(chip) >> p & 1 ? &chip->vram[p * CORE_VRAM_SIZE]
+                                        : NULL;
+}
+
+/*
+ * Queues a sound event with the current sound state. When the queue is full
+ * the newest event is replaced, so the last state always gets through.
+ */
+static void sound_event(CHIP8 chip) {
+  uint8_t n = chip->sound_event_count;
+
+  if (n == SOUND_EVENTS)
+    n--;
+#ifdef CHIP_SUPER_CHIP
+  chip->sound_events[n] = (ChipSoundEvent){
+      .cycle = chip->cycle, .on = chip->st > 0, .audio = chip->audio};
+#else
+  chip->sound_events[n] =
+      (ChipSoundEvent){.cycle = chip->cycle,
+                       .on = chip->st > 0,
+                       .audio = {.pitch = AUDIO_DEFAULT_PITCH}};
+#endif
+  chip->sound_event_count = n + 1;
+}
+
+/* Called once per 60 Hz frame, which is also the vertical blank. */
+static void core_update_timers(CHIP8 chip) {
+  if (chip->dt)
+    chip->dt--;
+  if (chip->st && --chip->st == 0)
+    sound_event(chip);
+
+  chip->vblank = true;
+  if (chip->status == CHIP_WAITING_VBLANK)
+    chip->status = CHIP_RUNNING;
+}
+
+static bool core_is_sound_timer_active(CHIP8 chip) { return chip->st > 0; }
+
+/* Instructions executed since chip_init. */
+static uint64_t core_get_cycle(CHIP8 chip) { return chip->cycle; }
+
+/* Copies out the sound events since the last call, up to SOUND_EVENTS. */
+static size_t core_take_sound_events(CHIP8 chip, ChipSoundEvent *events) {
+  size_t n = chip->sound_event_count;
+
+  memcpy(events, chip->sound_events, n * sizeof(ChipSoundEvent));
+  chip->sound_event_count = 0;
+  return n;
+}
+
+/* The state is cleared first, so padding and unused fields are zero. */
+static void core_save_state(CHIP8 chip, ChipState *state) {
+  memset(state, 0, sizeof(ChipState));
+  state->rng = chip->rng.state;
+  state->cycle = chip->cycle;
+  memcpy(state->vram, chip->vram, sizeof(chip->vram));
+  memcpy(state->mem, chip->mem, CORE_MEM_SIZE);
+  memcpy(state->stack, chip->stack, sizeof(chip->stack));
+  state->pc = chip->pc;
+  state->index = chip->index;
+  state->input = chip->input;
+  memcpy(state->regs, chip->regs, REGS_COUNT);
+  state->sp = chip->sp;
+  state->dt = chip->dt;
+  state->st = chip->st;
+  state->input_key = chip->input_key;
+  state->quirks = chip->quirks;
+  state->status = chip->status;
+  state->vblank = chip->vblank;
+  state->screen_width = CORE_WIDTH;
+  state->screen_height = CORE_HEIGHT;
+  state->planes = CORE_PLANES;
+#ifdef CHIP_SUPER_CHIP
+  state->hires = chip->hires_mode_enabled;
+  state->audio = chip->audio;
+#endif
+#ifdef CHIP_XO_CHIP
+  state->selected_planes = chip->planes;
+#endif
+}
+
+/*
+ * Returns false, leaving the chip alone, if the state was saved by another
+ * core. The whole screen is marked dirty and the current sound is sent as
+ * an event, as nothing of the previous run carries over.
+ */
+static bool core_load_state(CHIP8 chip, const ChipState *state) {
+  if (state->screen_width != CORE_WIDTH ||
+      state->screen_height != CORE_HEIGHT || state->planes != CORE_PLANES ||
+      state->sp >= STACK_SIZE)
+    return false;
+#ifndef CHIP_SUPER_CHIP
+  if (state->hires)
+    return false;
+#endif
+
+  chip->rng.state = state->rng;
+  chip->cycle = state->cycle;
+  memcpy(chip->vram, state->vram, sizeof(chip->vram));
+  memcpy(chip->mem, state->mem, CORE_MEM_SIZE);
+  memcpy(chip->stack, state->stack, sizeof(chip->stack));
+  chip->pc = state->pc;
+  chip->index = state->index;
+  chip->input = state->input;
+  memcpy(chip->regs, state->regs, REGS_COUNT);
+  chip->sp = state->sp;
+  chip->dt = state->dt;
+  chip->st = state->st;
+  chip->input_key = state->input_key;
+  chip->quirks = state->quirks;
+  bind_quirks(chip);
+  chip->status = state->status;
+  chip->vblank = state->vblank;
+#ifdef CHIP_SUPER_CHIP
+  chip->hires_mode_enabled = state->hires;
+  chip->audio = state->audio;
+#endif
+#ifdef CHIP_XO_CHIP
+  chip->planes = state->selected_planes & 3;
+#endif
+
+  invalidate_all(chip);
+  touch_rows(chip, ALL_ROWS);
+  chip->sound_event_count = 0;
+  sound_event(chip);
+
+  return true;
+}
+
+#ifdef CHIP_PROFILE
+static const ChipProfile *core_get_profile(CHIP8 chip) {
+  for (uint16_t addr = 0; addr < MEM_SIZE; addr++)
+    profile_settle(chip, addr);
+
+  return &chip->profile;
+}
+#else
+static const ChipProfile *core_get_profile(CHIP8 chip) { return NULL; }
+#endif
+
+static ChipStatus core_get_status(CHIP8 chip) { return chip->status; }
+static uint16_t core_get_pc(CHIP8 chip) { return chip->pc; }
+
+#ifdef CHIP_SUPER_CHIP
+/* Doubles every bit of a sprite row, for drawing in lores mode. */
+static uint32_t widen_sprite(uint16_t bits) {
+  uint32_t v = bits;
+
+  v = (v | v << 8) & 0x00FF00FF;
+  v = (v | v << 4) & 0x0F0F0F0F;
+  v = (v | v << 2) & 0x33333333;
+  v = (v | v << 1) & 0x55555555;
+  return v | v << 1;
+}
+
+/*
+ * Moves a row of width bits to x pixels from the left edge of a screen row,
+ * wrapping or clipping at its right edge.
+ */
+static void place_row(uint64_t row[ROW_WORDS], uint32_t bits, uint8_t width,
+                      uint8_t x, bool clip) {
+  uint64_t line = (uint64_t)bits << (VRAM_WORD_BITS - width);
+
+  if (x == 0) {
+    row[0] = line;
+    row[1] = 0;
+  } else if (x < VRAM_WORD_BITS) {
+    row[0] = line >> x;
+    row[1] = line << (VRAM_WORD_BITS - x);
+  } else {
+    row[0] = clip || x == VRAM_WORD_BITS ? 0
+                                          : line << (2 * VRAM_WORD_BITS - x);
+    row[1] = line >> (x - VRAM_WORD_BITS);
+  }
+}
+
+/*
+ * Draws a sprite of rows lines, width bits each, into the rows of one
+ * plane. In lores mode every sprite pixel covers 2x2 screen pixels and only
+ * the top left one is checked for a collision. Returns the colliding sprite
+ * pixels and adds the rows drawn to touched.
+ */
+static inline uint16_t draw_plane(CHIP8 chip, const Instr *in, uint64_t *vram,
+                                  const uint16_t *sprite, uint8_t rows,
+                                  uint8_t width, bool clip,
+                                  uint64_t *touched) {
+  bool lores = !chip->hires_mode_enabled;
+  uint8_t height = lores ? CORE_HEIGHT / 2 : CORE_HEIGHT;
+  uint8_t x = chip->regs[in->x] & (CORE_WIDTH - 1);
+  uint8_t y = chip->regs[in->y] & (CORE_HEIGHT - 1);
+  uint16_t hits = 0;
+
+  if (lores && x >= CORE_WIDTH / 2) {
+    if (clip)
+      rows = 0;
+    x &= CORE_WIDTH / 2 - 1;
+  }
+
+  for (uint8_t row = 0; row < rows; row++) {
+    uint64_t line[ROW_WORDS], *dst;
+    uint8_t posy = y + row;
+
+    if (posy >= height) {
+      if (clip)
+        continue;
+      posy &= height - 1;
+    }
+
+    if (lores) {
+      place_row(line, widen_sprite(sprite[row]), width * 2, x * 2, clip);
+      dst = &vram[posy * 2 * ROW_WORDS];
+      for (uint8_t w = 0; w < ROW_WORDS; w++) {
+        hits += __builtin_popcountll(dst[w] & line[w] & LEFT_PIXELS);
+        dst[w] ^= line[w];
+        dst[w + ROW_WORDS] ^= line[w];
+      }
+      *touched |= 3ull << posy * 2;
+    } else {
+      place_row(line, sprite[row], width, x, clip);
+      dst = &vram[posy * ROW_WORDS];
+      for (uint8_t w = 0; w < ROW_WORDS; w++) {
+        hits += __builtin_popcountll(dst[w] & line[w]);
+        dst[w] ^= line[w];
+      }
+      *touched |= 1ull << posy;
+    }
+  }
+
+  return hits;
+}
+
+/*
+ * Draws a sprite of rows lines, width bits each, from I into every
+ * selected plane, the data of a plane following that of the one before.
+ * VF counts the colliding sprite pixels, on the XO-CHIP it is set on any
+ * collision.
+ */
+static inline void draw_sprite(CHIP8 chip, const Instr *in, uint8_t rows,
+                               uint8_t width, bool clip) {
+  uint8_t bytes = width / SPRITE_SIZE;
+  uint16_t sprite[WIDE_SPRITE_SIZE];
+  uint16_t addr = chip->index, hits = 0;
+  uint64_t touched = 0;
+
+  for (uint8_t p = 0; p < CORE_PLANES; p++) {
+    uint64_t *vram = selected_plane(chip, p);
+
+    if (vram == NULL)
+      continue;
+
+    for (uint8_t row = 0; row < rows; row++) {
+      uint16_t at = (addr + row * bytes) & (CORE_MEM_SIZE - 1);
+
+      sprite[row] = bytes == 1 ? chip->mem[at]
+                               : chip->mem[at] << 8 |
+                                     chip->mem[(at + 1) & (CORE_MEM_SIZE - 1)];
+    }
+    PROFILE_READS(chip, addr, rows * bytes);
+    addr += rows * bytes;
+
+    hits += draw_plane(chip, in, vram, sprite, rows, width, clip, &touched);
+  }
+
+#ifdef CHIP_XO_CHIP
+  chip->regs[0xF] = hits != 0;
+#else
+  chip->regs[0xF] = hits;
+#endif
+  if (touched)
+    touch_rows(chip, touched);
+}
+
+/*
+ * Moves every row of a plane by pixels, to the right if right is set. A row
+ * is one 128-bit value with its left word first, so the bits leaving one
+ * word enter the other.
+ */
+static void scroll_plane(uint64_t *vram, uint8_t pixels, bool right) {
+  uint64_t *row = vram, *end = vram + CORE_VRAM_SIZE;
+
+#if defined(__AVX2__)
+  __m128i n = _mm_cvtsi32_si128(pixels);
+  __m128i carry = _mm_cvtsi32_si128(VRAM_WORD_BITS - pixels);
+
+  for (; row < end; row += 2 * ROW_WORDS) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)row);
+
+    if (right)
+      v = _mm256_or_si256(_mm256_srl_epi64(v, n),
+                          _mm256_sll_epi64(_mm256_bslli_epi128(v, 8), carry));
+    else
+      v = _mm256_or_si256(_mm256_sll_epi64(v, n),
+                          _mm256_srl_epi64(_mm256_bsrli_epi128(v, 8), carry));
+    _mm256_storeu_si256((__m256i *)row, v);
+  }
+#elif defined(__SSE2__)
+  __m128i n = _mm_cvtsi32_si128(pixels);
+  __m128i carry = _mm_cvtsi32_si128(VRAM_WORD_BITS - pixels);
+
+  for (; row < end; row += ROW_WORDS) {
+    __m128i v = _mm_loadu_si128((const __m128i *)row);
+
+    if (right)
+      v = _mm_or_si128(_mm_srl_epi64(v, n),
+                       _mm_sll_epi64(_mm_slli_si128(v, 8), carry));
+    else
+      v = _mm_or_si128(_mm_sll_epi64(v, n),
+                       _mm_srl_epi64(_mm_srli_si128(v, 8), carry));
+    _mm_storeu_si128((__m128i *)row, v);
+  }
+#else
+  for (; row < end; row += ROW_WORDS) {
+    if (right) {
+      row[1] = row[1] >> pixels | row[0] << (VRAM_WORD_BITS - pixels);
+      row[0] >>= pixels;
+    } else {
+      row[0] = row[0] << pixels | row[1] >> (VRAM_WORD_BITS - pixels);
+      row[1] <<= pixels;
+    }
+  }
+#endif
+}
+
+/* Scrolls the selected planes sideways, see scroll_plane. */
+static void scroll_rows(CHIP8 chip, uint8_t pixels, bool right) {
+  for (uint8_t p = 0; p < CORE_PLANES; p++) {
+    uint64_t *vram = selected_plane(chip, p);
+
+    if (vram != NULL)
+      scroll_plane(vram, pixels, right);
+  }
+  touch_rows(chip, ALL_ROWS);
+}
+#else
+/* Moves a row right by x pixels, wrapping or clipping at the screen edge. */
+static uint64_t place_row(uint64_t line, uint8_t x, bool clip) {
+  if (clip)
+    return line >> x;
+  return line >> x | line << ((SCREEN_WIDTH - x) & (SCREEN_WIDTH - 1));
+}
+#endif
+
+/*
+ * Stops the machine with pc left on the instruction that caused it.
+ * chip_run_cycles returns right after it, counting that instruction.
+ */
+static void halt(CHIP8 chip, ChipStatus status) {
+  chip->status = status;
+  chip->pc -= 2;
+}
+
+/*
+ * With the DISPLAY quirk sprites, only lores ones on the Super-Chip, are
+ * drawn right after a vertical blank, so a draw waits for the next
+ * chip_update_timers call. Only the display variants of the draw handlers
+ * call it.
+ */
+static bool wait_vblank(CHIP8 chip) {
+#ifdef CHIP_SUPER_CHIP
+  if (chip->hires_mode_enabled)
+    return false;
+#endif
+
+  if (!chip->vblank) {
+    halt(chip, CHIP_WAITING_VBLANK);
+    return true;
+  }
+
+  chip->vblank = false;
+  return false;
+}
+
+/*
+ * Steps over the instruction at pc, for the skip instructions. On the
+ * XO-CHIP that may be F000 NNNN, which is four bytes long.
+ */
+static inline void skip(CHIP8 chip) {
+#ifdef CHIP_XO_CHIP
+  uint16_t next = (chip->pc + 1) & (CORE_MEM_SIZE - 1);
+
+  if (chip->mem[chip->pc] == 0xF0 && chip->mem[next] == 0x00) {
+    chip->pc += 4;
+    return;
+  }
+#endif
+  chip->pc += 2;
+}
+
+static void opcode_unsupported(CHIP8 chip, const Instr *in) {
+  halt(chip, CHIP_UNSUPPORTED_OPCODE);
+}
+
+static void opcode_1xxx(CHIP8 chip, const Instr *in) { chip->pc = in->nnn; }
+
+static void opcode_6xkk(CHIP8 chip, const Instr *in) {
+  uint8_t x = in->x;
+  uint8_t value = in->kk;
+
+  chip->regs[x] = value;
+}
+
+static void opcode_7xkk(CHIP8 chip, const Instr *in) {
+  uint8_t x = in->x;
+  uint8_t value = in->kk;
+
+  chip->regs[x] += value;
+}
+
+static void opcode_00E0(CHIP8 chip, const Instr *in) {
+  for (uint8_t p = 0; p < CORE_PLANES; p++) {
+    uint64_t *vram = selected_plane(chip, p);
+
+    if (vram != NULL)
+      memset(vram, 0, CORE_VRAM_SIZE * sizeof(uint64_t));
+  }
+  touch_rows(chip, ALL_ROWS);
+}
+
+static void opcode_00EE(CHIP8 chip, const Instr *in) {
+  if (chip->sp > 0)
+    chip->pc = chip->stack[chip->sp--];
+}
+
+static void opcode_2nnn(CHIP8 chip, const Instr *in) {
+  if (chip->sp == STACK_SIZE - 1) {
+    halt(chip, CHIP_STACK_OVERFLOW);
+    return;
+  }
+
+  chip->stack[++chip->sp] = chip->pc;
+  chip->pc = in->nnn;
+}
+
+static void opcode_3xkk(CHIP8 chip, const Instr *in) {
+  uint8_t x = in->x;
+  uint8_t value = in->kk;
+
+  if (chip->regs[x] == value)
+    skip(chip);
+}
+
+static void opcode_4xkk(CHIP8 chip, const Instr *in) {
+  uint8_t x = in->x;
+  uint8_t value = in->kk;
+
+  if (chip->regs[x] != value)
+    skip(chip);
+}
+
+static void opcode_5xy0(CHIP8 chip, const Instr *in) {
+  uint8_t x = in->x;
+  uint8_t y = in->y;
+
+  if (chip->regs[x] == chip->regs[y])
+    skip(chip);
+}
+
+static void opcode_9xy0(CHIP8 chip, const Instr *in) {
+  uint8_t x = in->x;
+  uint8_t y = in->y;
+
+  if (chip->regs[x] != chip->regs[y])
+    skip(chip);
+}
+
+static void opcode_8xy0(CHIP8 chip, const Instr *in) {
+  uint8_t x = in->x;
+  uint8_t y = in->y;
+
+  chip->regs[x] = chip->regs[y];
+}
+
+static inline void logic_8xy1(CHIP8 chip, const Instr *in, bool vf_reset) {
+  uint8_t x = in->x;
+  uint8_t y = in->y;
+
+  chip->regs[x] |= chip->regs[y];
+  if (vf_reset)
+    chip->regs[0xF] = 0;
+}
+
+static void opcode_8xy1(CHIP8 chip, const Instr *in) {
+  logic_8xy1(chip, in, false);
+}
+
+static void opcode_8xy1_vfreset(CHIP8 chip, const Instr *in) {
+  logic_8xy1(chip, in, true);
+}
+
+static inline void logic_8xy2(CHIP8 chip, const Instr *in, bool vf_reset) {
+  uint8_t x = in->x;
+  uint8_t y = in->y;
+
+  chip->regs[x] &= chip->regs[y];
+  if (vf_reset)
+    chip->regs[0xF] = 0;
+}
+
+static void opcode_8xy2(CHIP8 chip, const Instr *in) {
+  logic_8xy2(chip, in, false);
+}
+
+static void opcode_8xy2_vfreset(CHIP8 chip, const Instr *in) {
+  logic_8xy2(chip, in, true);
+}
+
+static inline void logic_8xy3(CHIP8 chip, const Instr *in, bool vf_reset) {
+  uint8_t x = in->x;
+  uint8_t y = in->y;
+
+  chip->regs[x] ^= chip->regs[y];
+  if (vf_reset)
+    chip->regs[0xF] = 0;
+}
+
+static void opcode_8xy3(CHIP8 chip, const Instr *in) {
+  logic_8xy3(chip, in, false);
+}
+
+static void opcode_8xy3_vfreset(CHIP8 chip, const Instr *in) {
+  logic_8xy3(chip, in, true);
+}
+
+static void opcode_8xy4(CHIP8 chip, const Instr *in) {
+  uint8_t x = in->x;
+  uint8_t y = in->y;
+
+  uint8_t vf = 255 - chip->regs[x] < chip->regs[y] ? 1 : 0;
+  chip->regs[x] += chip->regs[y];
+  chip->regs[0xF] = vf;
+}
+
+static void opcode_8xy5(CHIP8 chip, const Instr *in) {
+  uint8_t x = in->x;
+  uint8_t y = in->y;
+
+  uint8_t vf = chip->regs[x] >= chip->regs[y] ? 1 : 0;
+  chip->regs[x] -= chip->regs[y];
+  chip->regs[0xF] = vf;
+}
+
+static inline void shift_8xy6(CHIP8 chip, const Instr *in, bool shifting) {
+  uint8_t x = in->x;
+  uint8_t vf;
+
+  if (!shifting) {
+    uint8_t y = in->y;
+    chip->regs[x] = chip->regs[y];
+  }
+
+  vf = chip->regs[x] & 0x1;
+  chip->regs[x] >>= 1;
+  chip->regs[0xF] = vf;
+}
+
+static void opcode_8xy6(CHIP8 chip, const Instr *in) {
+  shift_8xy6(chip, in, false);
+}
+
+static void opcode_8xy6_shifting(CHIP8 chip, const Instr *in) {
+  shift_8xy6(chip, in, true);
+}
+
+static void opcode_8xy7(CHIP8 chip, const Instr *in) {
+  uint8_t x = in->x;
+  uint8_t y = in->y;
+
+  uint8_t vf = chip->regs[y] >= chip->regs[x] ? 1 : 0;
+  chip->regs[x] = chip->regs[y] - chip->regs[x];
+  chip->regs[0xF] = vf;
+}
+
+static inline void shift_8xyE(CHIP8 chip, const Instr *in, bool shifting) {
+  uint8_t x = in->x;
+  uint8_t vf;
+
+  if (!shifting) {
+    uint8_t y = in->y;
+    chip->regs[x] = chip->regs[y];
+  }
+
+  vf = (chip->regs[x] >> 7) & 0x1;
+  chip->regs[x] <<= 1;
+  chip->regs[0xF] = vf;
+}
+
+static void opcode_8xyE(CHIP8 chip, const Instr *in) {
+  shift_8xyE(chip, in, false);
+}
+
+static void opcode_8xyE_shifting(CHIP8 chip, const Instr *in) {
+  shift_8xyE(chip, in, true);
+}
+
+static void opcode_Annn(CHIP8 chip, const Instr *in) { chip->index = in->nnn; }
+
+static void opcode_Bnnn(CHIP8 chip, const Instr *in) {
+  chip->pc = in->nnn + chip->regs[0];
+}
+
+static void opcode_Bnnn_jumping(CHIP8 chip, const Instr *in) {
+  chip->pc = in->nnn + chip->regs[in->x];
+}
+
+static void opcode_Cxkk(CHIP8 chip, const Instr *in) {
+  uint8_t rv = (uint8_t)(rng_next(&chip->rng) >> 24);
+  uint8_t x = in->x;
+  uint8_t value = in->kk;
+
+  chip->regs[x] = rv & value;
+}
+
+#ifdef CHIP_SUPER_CHIP
+static inline void draw_Dxyn(CHIP8 chip, const Instr *in, bool display,
+                             bool clip) {
+  if (display && wait_vblank(chip))
+    return;
+
+  draw_sprite(chip, in, in->n, SPRITE_SIZE, clip);
+}
+#else
+static inline void draw_Dxyn(CHIP8 chip, const Instr *in, bool display,
+                             bool clip) {
+  if (display && wait_vblank(chip))
+    return;
+
+  uint8_t x = chip->regs[in->x] & (SCREEN_WIDTH - 1);
+  uint8_t y = chip->regs[in->y] & (SCREEN_HEIGHT - 1);
+  uint8_t rows = in->n;
+  uint64_t hits = 0, touched = 0;
+
+  if (clip && rows > SCREEN_HEIGHT - y)
+    rows = SCREEN_HEIGHT - y;
+  PROFILE_READS(chip, chip->index, rows);
+
+  for (uint8_t row = 0; row < rows; row++) {
+    uint64_t line =
+        (uint64_t)chip->mem[(chip->index + row) & (CORE_MEM_SIZE - 1)]
+        << (SCREEN_WIDTH - SPRITE_SIZE);
+    uint8_t posy = (y + row) & (SCREEN_HEIGHT - 1);
+    uint64_t *dst = &chip->vram[posy];
+
+    line = place_row(line, x, clip);
+    hits |= *dst & line;
+    *dst ^= line;
+    touched |= 1ull << posy;
+  }
+
+  chip->regs[0xF] = hits != 0;
+  if (touched)
+    touch_rows(chip, touched);
+}
+#endif
+
+static void opcode_Dxyn(CHIP8 chip, const Instr *in) {
+  draw_Dxyn(chip, in, false, false);
+}
+
+static void opcode_Dxyn_clipping(CHIP8 chip, const Instr *in) {
+  draw_Dxyn(chip, in, false, true);
+}
+
+static void opcode_Dxyn_display(CHIP8 chip, const Instr *in) {
+  draw_Dxyn(chip, in, true, false);
+}
+
+static void opcode_Dxyn_display_clipping(CHIP8 chip, const Instr *in) {
+  draw_Dxyn(chip, in, true, true);
+}
+
+static void opcode_Ex9E(CHIP8 chip, const Instr *in) {
+  uint8_t x = in->x;
+  uint8_t vx = chip->regs[x] & 0xF;
+
+  if (chip->input & (1 << vx))
+    skip(chip);
+}
+
+static void opcode_ExA1(CHIP8 chip, const Instr *in) {
+  uint8_t x = in->x;
+  uint8_t vx = chip->regs[x] & 0xF;
+
+  if (!(chip->input & (1 << vx)))
+    skip(chip);
+}
+
+static void opcode_Fx07(CHIP8 chip, const Instr *in) {
+  uint8_t x = in->x;
+  chip->regs[x] = chip->dt;
+}
+
+static void opcode_Fx0A(CHIP8 chip, const Instr *in) {
+  if (chip->input) {
+    uint8_t x = in->x;
+    chip->regs[x] = chip->input_key;
+  } else {
+    chip->pc -= 2;
+  }
+}
+
+static void opcode_Fx15(CHIP8 chip, const Instr *in) {
+  uint8_t x = in->x;
+  chip->dt = chip->regs[x];
+}
+
+static void opcode_Fx18(CHIP8 chip, const Instr *in) {
+  uint8_t x = in->x;
+  bool on = chip->st > 0;
+
+  chip->st = chip->regs[x];
+  if (on != (chip->st > 0))
+    sound_event(chip);
+}
+
+static void opcode_Fx29(CHIP8 chip, const Instr *in) {
+  uint8_t x = in->x;
+  chip->index = (chip->regs[x] & 0xF) * 5;
+}
+
+static void opcode_Fx33(CHIP8 chip, const Instr *in) {
+  uint8_t x = in->x;
+  uint8_t i = 3;
+  uint8_t vx = chip->regs[x];
+
+  while (i) {
+    chip->mem[(chip->index + i - 1) & (CORE_MEM_SIZE - 1)] = vx % 10;
+    i--;
+    vx /= 10;
+  }
+
+  PROFILE_WRITES(chip, chip->index, 3);
+  invalidate(chip, chip->index, 3);
+}
+
+static inline void store_Fx55(CHIP8 chip, const Instr *in, bool memory) {
+  uint8_t x = in->x;
+
+  for (int i = 0; i <= x; i++)
+    chip->mem[(chip->index + i) & (CORE_MEM_SIZE - 1)] = chip->regs[i];
+  PROFILE_WRITES(chip, chip->index, x + 1);
+  invalidate(chip, chip->index, x + 1);
+
+  if (memory)
+    chip->index += x + 1;
+}
+
+static void opcode_Fx55(CHIP8 chip, const Instr *in) {
+  store_Fx55(chip, in, false);
+}
+
+static void opcode_Fx55_memory(CHIP8 chip, const Instr *in) {
+  store_Fx55(chip, in, true);
+}
+
+static inline void load_Fx65(CHIP8 chip, const Instr *in, bool memory) {
+  uint8_t x = in->x;
+
+  for (int i = 0; i <= x; i++)
+    chip->regs[i] = chip->mem[(chip->index + i) & (CORE_MEM_SIZE - 1)];
+  PROFILE_READS(chip, chip->index, x + 1);
+
+  if (memory)
+    chip->index += x + 1;
+}
+
+static void opcode_Fx65(CHIP8 chip, const Instr *in) {
+  load_Fx65(chip, in, false);
+}
+
+static void opcode_Fx65_memory(CHIP8 chip, const Instr *in) {
+  load_Fx65(chip, in, true);
+}
+
+static void opcode_Fx1E(CHIP8 chip, const Instr *in) {
+  uint8_t x = in->x;
+  chip->index += chip->regs[x];
+}
+
+#ifdef CHIP_SUPER_CHIP
+static void opcode_00FF(CHIP8 chip, const Instr *in) {
+  chip->hires_mode_enabled = true;
+}
+
+static void opcode_00FE(CHIP8 chip, const Instr *in) {
+  chip->hires_mode_enabled = false;
+}
+
+static void opcode_00Cn(CHIP8 chip, const Instr *in) {
+  uint16_t rows = in->n;
+
+  if (!chip->hires_mode_enabled)
+    rows *= 2;
+
+  for (uint8_t p = 0; p < CORE_PLANES; p++) {
+    uint64_t *vram = selected_plane(chip, p);
+
+    if (vram == NULL)
+      continue;
+    memmove(&vram[rows * ROW_WORDS], vram,
+            (CORE_HEIGHT - rows) * ROW_WORDS * sizeof(uint64_t));
+    memset(vram, 0, rows * ROW_WORDS * sizeof(uint64_t));
+  }
+  touch_rows(chip, ALL_ROWS);
+}
+
+static void opcode_00FB(CHIP8 chip, const Instr *in) {
+  scroll_rows(chip, chip->hires_mode_enabled ? 4 : 8, true);
+}
+
+static void opcode_00FC(CHIP8 chip, const Instr *in) {
+  scroll_rows(chip, chip->hires_mode_enabled ? 4 : 8, false);
+}
+
+static inline void draw_Dxy0(CHIP8 chip, const Instr *in, bool display,
+                             bool clip) {
+  if (display && wait_vblank(chip))
+    return;
+
+  draw_sprite(chip, in, WIDE_SPRITE_SIZE, WIDE_SPRITE_SIZE, clip);
+}
+
+static void opcode_Dxy0(CHIP8 chip, const Instr *in) {
+  draw_Dxy0(chip, in, false, false);
+}
+
+static void opcode_Dxy0_clipping(CHIP8 chip, const Instr *in) {
+  draw_Dxy0(chip, in, false, true);
+}
+
+static void opcode_Dxy0_display(CHIP8 chip, const Instr *in) {
+  draw_Dxy0(chip, in, true, false);
+}
+
+static void opcode_Dxy0_display_clipping(CHIP8 chip, const Instr *in) {
+  draw_Dxy0(chip, in, true, true);
+}
+
+static void opcode_Fx30(CHIP8 chip, const Instr *in) {
+  uint8_t x = in->x;
+  chip->index = WIDE_FONTS_START_ADDRESS + (chip->regs[x] & 0xF) * 10;
+}
+
+static void opcode_Fx75(CHIP8 chip, const Instr *in) {}
+static void opcode_Fx85(CHIP8 chip, const Instr *in) {}
+
+/* XO-CHIP audio: loads the 16 byte sound pattern from I. */
+static void opcode_F002(CHIP8 chip, const Instr *in) {
+  for (uint8_t i = 0; i < AUDIO_PATTERN_SIZE; i++)
+    chip->audio.pattern[i] = chip->mem[(chip->index + i) & (CORE_MEM_SIZE - 1)];
+  chip->audio.pattern_loaded = true;
+  sound_event(chip);
+}
+
+/* XO-CHIP audio: sets the playback pitch of the pattern to VX. */
+static void opcode_Fx3A(CHIP8 chip, const Instr *in) {
+  chip->audio.pitch = chip->regs[in->x];
+  sound_event(chip);
+}
+
+static void opcode_00FD(CHIP8 chip, const Instr *in) {
+  halt(chip, CHIP_EXITED);
+}
+#endif
+
+#ifdef CHIP_XO_CHIP
+/* Scrolls the selected planes up by n pixels, twice that in lores. */
+static void opcode_00Dn(CHIP8 chip, const Instr *in) {
+  uint16_t rows = in->n;
+
+  if (!chip->hires_mode_enabled)
+    rows *= 2;
+
+  for (uint8_t p = 0; p < CORE_PLANES; p++) {
+    uint64_t *vram = selected_plane(chip, p);
+
+    if (vram == NULL)
+      continue;
+    memmove(vram, &vram[rows * ROW_WORDS],
+            (CORE_HEIGHT - rows) * ROW_WORDS * sizeof(uint64_t));
+    memset(&vram[(CORE_HEIGHT - rows) * ROW_WORDS], 0,
+           rows * ROW_WORDS * sizeof(uint64_t));
+  }
+  touch_rows(chip, ALL_ROWS);
+}
+
+/* Stores VX to VY, counting down if X is above Y, from I on. I stays. */
+static void opcode_5xy2(CHIP8 chip, const Instr *in) {
+  int8_t step = in->x <= in->y ? 1 : -1;
+  uint8_t count = (in->x <= in->y ? in->y - in->x : in->x - in->y) + 1;
+
+  for (uint8_t i = 0; i < count; i++) {
+    uint16_t addr = (chip->index + i) & (CORE_MEM_SIZE - 1);
+
+    chip->mem[addr] = chip->regs[in->x + i * step];
+  }
+  PROFILE_WRITES(chip, chip->index, count);
+  invalidate(chip, chip->index, count);
+}
+
+/* Loads VX to VY, counting down if X is above Y, from I on. I stays. */
+static void opcode_5xy3(CHIP8 chip, const Instr *in) {
+  int8_t step = in->x <= in->y ? 1 : -1;
+  uint8_t count = (in->x <= in->y ? in->y - in->x : in->x - in->y) + 1;
+
+  for (uint8_t i = 0; i < count; i++) {
+    uint16_t addr = (chip->index + i) & (CORE_MEM_SIZE - 1);
+
+    chip->regs[in->x + i * step] = chip->mem[addr];
+  }
+  PROFILE_READS(chip, chip->index, count);
+}
+
+/* Loads I with the 16 bit address in the word after the opcode. */
+static void opcode_F000(CHIP8 chip, const Instr *in) {
+  uint16_t next = (chip->pc + 1) & (CORE_MEM_SIZE - 1);
+
+  chip->index = chip->mem[chip->pc] << 8 | chip->mem[next];
+  chip->pc += 2;
+}
+
+/* Selects the planes drawing, scrolling and clearing apply to. */
+static void opcode_Fn01(CHIP8 chip, const Instr *in) {
+  chip->planes = in->x & 3;
+}
+#endif
+
+static void opcode_nop(CHIP8 chip, const Instr *in) {}
+
+#ifndef CHIP_THREADED
+static Instr *fetch(CHIP8 chip) {
+  uint16_t addr = chip->pc & (CORE_MEM_SIZE - 1);
+  Instr *in = &chip->icache[addr];
+
+  if (in->exec == NULL)
+    decode(chip, in, addr);
+  PROFILE_EXEC(chip, addr);
+
+  chip->pc += 2;
+  return in;
+}
+
+static void execute(CHIP8 chip, const Instr *in) { in->exec(chip, in); }
+#endif
+
+#define OP_HANDLER(name) &opcode_##name,
+#define QUIRK_OP_HANDLER(name, quirk) &opcode_##name##_##quirk,
+static void (*const handlers[OP_BOUND_COUNT])(CHIP8, const Instr *) = {
+    CHIP_OPS(OP_HANDLER) CORE_QUIRK_OPS(QUIRK_OP_HANDLER)};
+#undef QUIRK_OP_HANDLER
+#undef OP_HANDLER
+
+/* Picks the handler variants for the quirks of the machine. */
+static void bind_quirks(CHIP8 chip) {
+  uint8_t draw = chip->quirks & DISPLAY
+                     ? (chip->quirks & CLIPPING ? 3 : 2)
+                     : (chip->quirks & CLIPPING ? 1 : 0);
+
+  for (uint8_t op = 0; op < OP_COUNT; op++)
+    chip->ops[op] = op;
+
+  if (chip->quirks & VF_RESET) {
+    chip->ops[OP_8xy1] = OP_8xy1_vfreset;
+    chip->ops[OP_8xy2] = OP_8xy2_vfreset;
+    chip->ops[OP_8xy3] = OP_8xy3_vfreset;
+  }
+  if (chip->quirks & SHIFTING) {
+    chip->ops[OP_8xy6] = OP_8xy6_shifting;
+    chip->ops[OP_8xyE] = OP_8xyE_shifting;
+  }
+  if (chip->quirks & JUMPING)
+    chip->ops[OP_Bnnn] = OP_Bnnn_jumping;
+  if (chip->quirks & MEMORY) {
+    chip->ops[OP_Fx55] = OP_Fx55_memory;
+    chip->ops[OP_Fx65] = OP_Fx65_memory;
+  }
+  /* The draw variants follow the plain one as clipping, display, both. */
+  if (draw) {
+    chip->ops[OP_Dxyn] = OP_Dxyn_clipping + draw - 1;
+#ifdef CHIP_SUPER_CHIP
+    chip->ops[OP_Dxy0] = OP_Dxy0_clipping + draw - 1;
+#endif
+  }
+#ifdef CHIP_THREADED
+  chip->labels_bound = false;
+#endif
+}
+
+/*
+ * Switches the quirks of a running machine. Everything decoded or
+ * translated under the old ones is dropped.
+ */
+static void core_set_quirks(CHIP8 chip, uint8_t quirks) {
+  chip->quirks = quirks;
+  bind_quirks(chip);
+  invalidate_all(chip);
+}
+
+static void decode(CHIP8 chip, Instr *in, uint16_t addr) {
+  uint16_t op_h, op_l;
+  ChipOp op;
+
+  op_h = chip->mem[addr] << 8;
+  op_l = chip->mem[(addr + 1) & (CORE_MEM_SIZE - 1)];
+  in->opcode = op_h | op_l;
+  in->nnn = in->opcode & 0xFFF;
+  in->x = (uint8_t)(in->opcode >> 8 & 0xF);
+  in->y = (uint8_t)(in->opcode >> 4 & 0xF);
+  in->kk = (uint8_t)(in->opcode & 0xFF);
+  in->n = (uint8_t)(in->opcode & 0xF);
+
+  op = opcode_classify(in->opcode);
+  PROFILE_DECODE(chip, addr, op);
+  in->exec = handlers[chip->ops[op]];
+  if (addr >= chip->icache_end)
+    chip->icache_end = addr + 1;
+}
+
+/*
+ * Drops predecoded entries overlapping the written range. An instruction
+ * starting one byte before the range also covers its first byte.
+ */
+static void invalidate(CHIP8 chip, uint16_t addr, size_t size) {
+  for (size_t i = 0; i <= size; i++)
+    chip->icache[(addr + i - 1) & (CORE_MEM_SIZE - 1)].exec = NULL;
+#ifdef CORE_JIT
+  jit_invalidate(chip, addr, size);
+#endif
+}
+
+/*
+ * Drops every predecoded entry. Only the ones below icache_end were ever
+ * decoded, so the untouched rest of a large cache stays unmapped.
+ */
+static void invalidate_all(CHIP8 chip) {
+  memset(chip->icache, 0, chip->icache_end * sizeof(Instr));
+  chip->icache_end = 0;
+#ifdef CORE_JIT
+  jit_invalidate(chip, 0, CORE_MEM_SIZE);
+#endif
+}
+
+#ifdef CHIP_THREADED
+#include CORE_OPTABLE
+
+/*
+ * Threaded dispatch: every handler label ends with its own fetch and
+ * indirect jump through the generated opcode table, so the branch
+ * predictor sees one jump site per handler instead of a single shared one.
+ * Operands still come from the predecode cache.
+ */
+static uint32_t core_run_cycles(CHIP8 chip, uint32_t cycles) {
+#define OP_LABEL(name) &&op_##name,
+#define QUIRK_OP_LABEL(name, quirk) &&op_##name##_##quirk,
+  static void *const labels[OP_BOUND_COUNT] = {
+      CHIP_OPS(OP_LABEL) CORE_QUIRK_OPS(QUIRK_OP_LABEL)};
+#undef QUIRK_OP_LABEL
+#undef OP_LABEL
+  void *const *bound = chip->labels;
+  Instr *icache = chip->icache;
+  uint32_t done = 0;
+  uint16_t addr;
+  Instr *in;
+
+  if (chip->status != CHIP_RUNNING)
+    return 0;
+
+  /* Labels only exist in here, so the variants are bound on the first run. */
+  if (!chip->labels_bound) {
+    for (uint8_t op = 0; op < OP_COUNT; op++)
+      chip->labels[op] = labels[chip->ops[op]];
+    chip->labels_bound = true;
+  }
+
+#define DISPATCH()                                                             \
+  do {                                                                         \
+    if (done == cycles)                                                        \
+      return done;                                                             \
+    done++;                                                                    \
+    chip->cycle++;                                                             \
+    addr = chip->pc & (CORE_MEM_SIZE - 1);                                     \
+    in = &icache[addr];                                                        \
+    if (in->exec == NULL)                                                      \
+      decode(chip, in, addr);                                                  \
+    PROFILE_EXEC(chip, addr);                                                  \
+    chip->pc += 2;                                                             \
+    goto *bound[optable[in->opcode]];                                          \
+  } while (0)
+
+  DISPATCH();
+
+#define OP_BODY(name)                                                          \
+  op_##name : opcode_##name(chip, in);                                         \
+  if (opcode_halts(OP_##name) && chip->status != CHIP_RUNNING)                 \
+    return done;                                                               \
+  DISPATCH();
+#define QUIRK_OP_BODY(name, quirk)                                             \
+  op_##name##_##quirk : opcode_##name##_##quirk(chip, in);                     \
+  if (opcode_halts(OP_##name) && chip->status != CHIP_RUNNING)                 \
+    return done;                                                               \
+  DISPATCH();
+  CHIP_OPS(OP_BODY)
+  CORE_QUIRK_OPS(QUIRK_OP_BODY)
+#undef QUIRK_OP_BODY
+#undef OP_BODY
+#undef DISPATCH
+}
+#endif
+
+#ifdef CORE_JIT
+#define REG_OFFSET(r) (int32_t)(offsetof(struct chip8, regs) + (r))
+#define PC_OFFSET (int32_t)offsetof(struct chip8, pc)
+#define INDEX_OFFSET (int32_t)offsetof(struct chip8, index)
+
+/*
+ * Block JIT: once a start address has been reached JIT_HOT_THRESHOLD times
+ * the straight-line code from there is translated up to the first branch,
+ * skip or memory write. Simple register ops are emitted inline; everything
+ * else calls the regular handler with its predecoded Instr.
+ */
+static bool jit_ends_block(ChipOp op) {
+  switch (op) {
+  case OP_1xxx:
+  case OP_2nnn:
+  case OP_00EE:
+  case OP_Bnnn:
+  case OP_3xkk:
+  case OP_4xkk:
+  case OP_5xy0:
+  case OP_9xy0:
+  case OP_Ex9E:
+  case OP_ExA1:
+  case OP_Fx0A:
+  case OP_Fx33:
+  case OP_Fx55:
+    return true;
+  default:
+    return false;
+  }
+}
+
+static void jit_emit_instr(CHIP8 chip, JitEmitter *e, ChipOp op,
+                           const Instr *in, uint16_t next_pc) {
+  switch (op) {
+  case OP_nop:
+    break;
+  case OP_1xxx:
+    jit_emit_store16(e, PC_OFFSET, in->nnn);
+    break;
+  case OP_6xkk:
+    jit_emit_store8(e, REG_OFFSET(in->x), in->kk);
+    break;
+  case OP_7xkk:
+    jit_emit_add8(e, REG_OFFSET(in->x), in->kk);
+    break;
+  case OP_8xy0:
+    jit_emit_load_al(e, REG_OFFSET(in->y));
+    jit_emit_store_al(e, REG_OFFSET(in->x));
+    break;
+  case OP_8xy1:
+  case OP_8xy2:
+  case OP_8xy3:
+    jit_emit_load_al(e, REG_OFFSET(in->y));
+    jit_emit_logic_al(e,
+                      op == OP_8xy1   ? JIT_OR
+                      : op == OP_8xy2 ? JIT_AND
+                                      : JIT_XOR,
+                      REG_OFFSET(in->x));
+    if (chip->quirks & VF_RESET)
+      jit_emit_store8(e, REG_OFFSET(0xF), 0);
+    break;
+  case OP_8xy4:
+    jit_emit_load_al(e, REG_OFFSET(in->x));
+    jit_emit_add_al(e, REG_OFFSET(in->y));
+    jit_emit_store_al(e, REG_OFFSET(in->x));
+    jit_emit_setcc_store(e, JIT_CARRY, REG_OFFSET(0xF));
+    break;
+  case OP_8xy5:
+    jit_emit_load_al(e, REG_OFFSET(in->x));
+    jit_emit_sub_al(e, REG_OFFSET(in->y));
+    jit_emit_store_al(e, REG_OFFSET(in->x));
+    jit_emit_setcc_store(e, JIT_NO_CARRY, REG_OFFSET(0xF));
+    break;
+  case OP_Annn:
+    jit_emit_store16(e, INDEX_OFFSET, in->nnn);
+    break;
+  default:
+    if (jit_ends_block(op))
+      jit_emit_store16(e, PC_OFFSET, next_pc);
+    jit_emit_call(e, (void (*)(void))in->exec, in);
+    break;
+  }
+}
+
+static bool jit_translate(CHIP8 chip, uint16_t start) {
+  JitBlock *block = &chip->blocks[start];
+  uint16_t addr = start, count = 0;
+  bool ended = false;
+  JitEmitter e;
+
+  if (chip->jit->used > JIT_CODE_SIZE / 2) {
+    memset(chip->blocks, 0, MEM_SIZE * sizeof(JitBlock));
+    memset(chip->translated, 0, MEM_SIZE * sizeof(uint8_t));
+    jit_buffer_reset(chip->jit);
+  }
+
+  jit_begin(chip->jit, &e);
+  jit_emit_prologue(&e);
+
+  while (!ended && count < JIT_BLOCK_MAX && addr < MEM_SIZE - 1) {
+    Instr *in = &chip->icache[addr];
+    ChipOp op;
+
+    if (in->exec == NULL)
+      decode(chip, in, addr);
+
+    op = opcode_classify(in->opcode);
+    /* Fx18 may stamp a sound event with the cycle, left to the interpreter. */
+    if (op == OP_unsupported || op == OP_Fx18 ||
+        (op == OP_Dxyn && chip->quirks & DISPLAY))
+      break;
+
+    addr += 2;
+    count++;
+    jit_emit_instr(chip, &e, op, in, addr);
+    ended = jit_ends_block(op);
+  }
+
+  if (count == 0)
+    return false;
+  if (!ended)
+    jit_emit_store16(&e, PC_OFFSET, addr);
+  jit_emit_epilogue(&e, count);
+
+  block->code = (JitBlockFn)(uintptr_t)jit_commit(chip->jit, &e);
+  if (block->code == NULL)
+    return false;
+
+  block->count = count;
+  block->size = addr - start;
+  memset(&chip->translated[start], 1, block->size);
+
+  return true;
+}
+
+/* Drops every block whose guest code overlaps the written range. */
+static void jit_invalidate(CHIP8 chip, uint16_t addr, size_t size) {
+  size_t from, to, i;
+  bool hit = false;
+
+  addr &= MEM_SIZE - 1;
+  if (addr + size > MEM_SIZE) {
+    jit_invalidate(chip, 0, addr + size - MEM_SIZE);
+    size = MEM_SIZE - addr;
+  }
+
+  from = addr;
+  to = addr + size;
+
+  for (i = from; i < to && i < MEM_SIZE; i++)
+    hit |= chip->translated[i];
+  if (!hit)
+    return;
+
+  from = from > JIT_BLOCK_MAX * 2 ? from - JIT_BLOCK_MAX * 2 : 0;
+  for (i = from; i < to && i < MEM_SIZE; i++) {
+    JitBlock *block = &chip->blocks[i];
+
+    if (block->code != NULL && i + block->size > addr) {
+      block->code = NULL;
+      block->hotness = 0;
+    }
+  }
+}
+
+static uint32_t core_run_cycles(CHIP8 chip, uint32_t cycles) {
+  uint32_t done = 0;
+
+  while (done < cycles && chip->status == CHIP_RUNNING) {
+    if (chip->pc < MEM_SIZE) {
+      JitBlock *block = &chip->blocks[chip->pc];
+
+      if (block->code == NULL && block->hotness < JIT_HOT_THRESHOLD &&
+          ++block->hotness == JIT_HOT_THRESHOLD)
+        jit_translate(chip, chip->pc);
+
+      if (block->code != NULL && block->count <= cycles - done) {
+        uint32_t count = block->code(chip);
+
+        done += count;
+        chip->cycle += count;
+        continue;
+      }
+    }
+
+    chip->cycle++;
+    execute(chip, fetch(chip));
+    done++;
+  }
+
+  return done;
+}
+#endif
+
+const ChipCore CORE_TABLE = {
+    .name = CORE_NAME,
+    .init = &core_init,
+    .destroy = &core_destroy,
+    .run_cycles = &core_run_cycles,
+    .update_timers = &core_update_timers,
+    .is_sound_timer_active = &core_is_sound_timer_active,
+    .get_cycle = &core_get_cycle,
+    .take_sound_events = &core_take_sound_events,
+    .get_status = &core_get_status,
+    .get_pc = &core_get_pc,
+    .load_rom = &core_load_rom,
+    .update_input = &core_update_input,
+    .get_input = &core_get_input,
+    .get_input_key = &core_get_input_key,
+    .get_vram_rows = &core_get_vram_rows,
+    .screen_width = CORE_WIDTH,
+    .screen_height = CORE_HEIGHT,
+    .planes = CORE_PLANES,
+    .mem_size = CORE_MEM_SIZE,
+    .get_vram_generation = &core_get_vram_generation,
+    .take_dirty_rows = &core_take_dirty_rows,
+    .get_frame = &core_get_frame,
+    .save_state = &core_save_state,
+    .load_state = &core_load_state,
+    .set_quirks = &core_set_quirks,
+    .get_profile = &core_get_profile};
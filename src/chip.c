@@ -1,590 +1,220 @@
 #include "chip.h"
-#include "utils.h"
-#include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
-#include <time.h>
 
-#define STACK_SIZE 12
+#define MAX_TRACE (MEM_SIZE / 2)
 
-struct chip8 {
-  uint16_t pc;
-  uint8_t *mem;
-  uint8_t *vram;
-  size_t vram_size;
-  uint8_t screen_width;
-  uint8_t screen_height;
-  uint16_t stack[STACK_SIZE];
+static const ChipCore *const cores[] = {&chip8_core, &super_chip_core,
+                                        &xo_chip_core};
 
-  uint16_t index;
-  uint8_t dt;
-  uint8_t st;
-  uint8_t sp;
-  uint8_t regs[REGS_COUNT];
-
-  uint16_t input;
-  uint8_t input_key;
-
-  uint16_t opcode;
-  void (*exec)(CHIP8);
-
-  uint8_t quirks;
-};
-
-static void fetch(CHIP8);
-static void decode(CHIP8);
-static void execute(CHIP8);
-
-CHIP8 chip_init(ChipConfig conf) {
-  srand(time(NULL));
-  CHIP8 chip = malloc(sizeof(struct chip8));
-
-  if (chip == NULL) {
-    terminate("Failed to allocate memory");
-  }
-
-  chip->mem = malloc(MEM_SIZE * sizeof(uint8_t));
-  if (chip->mem == NULL) {
-    chip_destroy(chip);
-    terminate("Failed to allocate memory");
-  }
-
-  size_t vram_size = VRAM_SIZE;
-
-  chip->vram = calloc(vram_size, sizeof(uint8_t));
-  if (chip->vram == NULL) {
-    chip_destroy(chip);
-    terminate("Failed to allocate memory");
-  }
-
-  chip->vram_size = vram_size;
-  chip->screen_width = SCREEN_WIDTH;
-  chip->screen_height = SCREEN_HEIGHT;
-  chip->pc = START_ADDRESS;
-  chip->index = 0;
-  chip->dt = 0;
-  chip->st = 0;
-  chip->sp = 0;
-  chip->input = 0;
-  chip->input_key = 0;
-  chip->quirks = conf.quirks;
-
-  uint8_t i;
-  for (i = 0; i < REGS_COUNT; i++) {
-    chip->regs[i] = 0;
-  }
-  for (i = 0; i < STACK_SIZE; i++) {
-    chip->stack[i] = 0;
-  }
-  for (i = 0; i < 80; i++) {
-    chip->mem[i] = font[i];
-  }
-
-  return chip;
-}
-
-void chip_destroy(CHIP8 chip) {
-  free(chip->mem);
-  free(chip->vram);
-  free(chip);
+/* A machine starts with a pointer to its core. */
+static const ChipCore *core(CHIP8 chip) {
+  return *(const ChipCore *const *)chip;
 }
 
-void chip_run_cycle(CHIP8 chip) {
-  fetch(chip);
-  decode(chip);
-  execute(chip);
+/* Returns the core called name, or NULL. */
+const ChipCore *chip_find_core(const char *name) {
+  for (size_t i = 0; i < sizeof(cores) / sizeof(cores[0]); i++)
+    if (strcmp(cores[i]->name, name) == 0)
+      return cores[i];
+  return NULL;
 }
 
-void chip_kb_btn_pressed(CHIP8 chip, uint8_t key) {
-  chip->input |= 1 << key;
-  chip->input_key = key;
-}
-
-void chip_kb_btn_released(CHIP8 chip, uint8_t key) { chip->input &= ~1 << key; }
-
-void chip_update_input(CHIP8 chip, uint16_t input, uint8_t key) {
-  chip->input = input;
-  chip->input_key = key;
-}
-
-void chip_load_rom(CHIP8 chip, uint8_t *rom, size_t size) {
-  memcpy(&chip->mem[START_ADDRESS], rom, size);
-}
-
-uint8_t *chip_get_vram_ref(CHIP8 chip) { return chip->vram; }
-uint8_t chip_get_screen_width(CHIP8 chip) { return chip->screen_width; }
-uint8_t chip_get_screen_height(CHIP8 chip) { return chip->screen_height; }
-
-void chip_update_timers(CHIP8 chip) {
-  if (chip->dt)
-    chip->dt--;
-  if (chip->st)
-    chip->st--;
-}
-
-bool chip_is_sound_timer_active(CHIP8 chip) { return chip->st > 0; }
-
-static void set_vram_data_at_pos(CHIP8 chip, size_t x, size_t y,
-                                 bool wide_pixel_mode) {
-  size_t screen_width = (size_t)chip->screen_width;
-  if (chip->vram[y * screen_width + x])
-    chip->regs[0xF] = 1;
-  chip->vram[y * screen_width + x] ^= 1;
-
-  if (wide_pixel_mode) {
-    chip->vram[y * screen_width + x + 1] ^= 1;
-    chip->vram[(y + 1) * screen_width + x] ^= 1;
-    chip->vram[(y + 1) * screen_width + x + 1] ^= 1;
+static bool is_super_chip_opcode(uint16_t opcode) {
+  switch (opcode & 0xF000) {
+  case 0x0000:
+    return (opcode & 0xFFF0) == 0x00C0 ||
+           (opcode >= 0x00FB && opcode <= 0x00FF);
+  case 0xD000:
+    return (opcode & 0xF) == 0;
+  case 0xF000:
+    switch (opcode & 0xFF) {
+    case 0x30:
+    case 0x75:
+    case 0x85:
+    case 0x3A:
+      return true;
+    default:
+      return opcode == 0xF002;
+    }
+  default:
+    return false;
   }
 }
 
-static void opcode_unsupported(CHIP8 chip) {
-  printf("WARNING: unsupported opcode %04X\n", chip->opcode);
-  exit(EXIT_FAILURE);
-}
-
-static void opcode_1xxx(CHIP8 chip) { chip->pc = chip->opcode & 0xFFF; }
-
-static void opcode_6xkk(CHIP8 chip) {
-  uint8_t x = (uint8_t)(chip->opcode >> 8 & 0xF);
-  uint8_t value = (uint8_t)(chip->opcode & 0xFF);
-
-  chip->regs[x] = value;
-}
-
-static void opcode_7xkk(CHIP8 chip) {
-  uint8_t x = (uint8_t)(chip->opcode >> 8 & 0xF);
-  uint8_t value = (uint8_t)(chip->opcode & 0xFF);
-
-  chip->regs[x] += value;
-}
-
-static void opcode_00E0(CHIP8 chip) {
-  for (uint16_t i = 0; i < chip->vram_size; i++)
-    chip->vram[i] = 0;
-}
-
-static void opcode_00EE(CHIP8 chip) {
-  if (chip->sp > 0)
-    chip->pc = chip->stack[chip->sp--];
-}
-
-static void opcode_2nnn(CHIP8 chip) {
-  chip->stack[++chip->sp] = chip->pc;
-  chip->pc = chip->opcode & 0xFFF;
-}
-
-static void opcode_3xkk(CHIP8 chip) {
-  uint8_t x = (uint8_t)(chip->opcode >> 8 & 0xF);
-  uint8_t value = (uint8_t)(chip->opcode & 0xFF);
-
-  if (chip->regs[x] == value)
-    chip->pc += 2;
-}
-
-static void opcode_4xkk(CHIP8 chip) {
-  uint8_t x = (uint8_t)(chip->opcode >> 8 & 0xF);
-  uint8_t value = (uint8_t)(chip->opcode & 0xFF);
-
-  if (chip->regs[x] != value)
-    chip->pc += 2;
-}
-
-static void opcode_5xy0(CHIP8 chip) {
-  uint8_t x = (uint8_t)(chip->opcode >> 8 & 0xF);
-  uint8_t y = (uint8_t)(chip->opcode >> 4 & 0xF);
-
-  if (chip->regs[x] == chip->regs[y])
-    chip->pc += 2;
-}
-
-static void opcode_9xy0(CHIP8 chip) {
-  uint8_t x = (uint8_t)(chip->opcode >> 8 & 0xF);
-  uint8_t y = (uint8_t)(chip->opcode >> 4 & 0xF);
-
-  if (chip->regs[x] != chip->regs[y])
-    chip->pc += 2;
-}
-
-static void opcode_8xy0(CHIP8 chip) {
-  uint8_t x = (uint8_t)(chip->opcode >> 8 & 0xF);
-  uint8_t y = (uint8_t)(chip->opcode >> 4 & 0xF);
-
-  chip->regs[x] = chip->regs[y];
-}
-
-static void opcode_8xy1(CHIP8 chip) {
-  uint8_t x = (uint8_t)(chip->opcode >> 8 & 0xF);
-  uint8_t y = (uint8_t)(chip->opcode >> 4 & 0xF);
-
-  chip->regs[x] |= chip->regs[y];
-  if (chip->quirks & VF_RESET)
-    chip->regs[0xF] = 0;
-}
-
-static void opcode_8xy2(CHIP8 chip) {
-  uint8_t x = (uint8_t)(chip->opcode >> 8 & 0xF);
-  uint8_t y = (uint8_t)(chip->opcode >> 4 & 0xF);
-
-  chip->regs[x] &= chip->regs[y];
-  if (chip->quirks & VF_RESET)
-    chip->regs[0xF] = 0;
+static bool is_xo_chip_opcode(uint16_t opcode) {
+  switch (opcode & 0xF000) {
+  case 0x0000:
+    return (opcode & 0xFFF0) == 0x00D0;
+  case 0x5000:
+    return (opcode & 0xF) == 2 || (opcode & 0xF) == 3;
+  case 0xF000:
+    return opcode == 0xF000 || (opcode & 0xFF) == 0x01;
+  default:
+    return false;
+  }
 }
 
-static void opcode_8xy3(CHIP8 chip) {
-  uint8_t x = (uint8_t)(chip->opcode >> 8 & 0xF);
-  uint8_t y = (uint8_t)(chip->opcode >> 4 & 0xF);
-
-  chip->regs[x] ^= chip->regs[y];
-  if (chip->quirks & VF_RESET)
-    chip->regs[0xF] = 0;
-}
+/*
+ * Picks the core for a rom by following its code from the start address:
+ * jumps, calls, both ways of every skip and returns. An XO-CHIP
+ * instruction on the way, or a rom too large for 4 KB, picks the XO-CHIP,
+ * else a Super-Chip one picks the Super-Chip, otherwise it's the CHIP-8.
+ * Only code is looked at, so sprite data that happens to look like a
+ * Super-Chip instruction doesn't count. Computed jumps end a path.
+ */
+const ChipCore *chip_detect_core(const uint8_t *rom, size_t size) {
+  const ChipCore *found = &chip8_core;
+  uint16_t pending[MAX_TRACE];
+  uint8_t seen[MEM_SIZE] = {0};
+  size_t count = 0;
+
+  if (size > MEM_SIZE - START_ADDRESS)
+    return &xo_chip_core;
+
+  pending[count++] = START_ADDRESS;
+  while (count) {
+    uint16_t addr = pending[--count], opcode, next[2];
+    size_t offset = addr - START_ADDRESS, targets = 0;
+
+    if (addr < START_ADDRESS || addr >= MEM_SIZE - 1 || offset + 1 >= size ||
+        seen[addr])
+      continue;
+    seen[addr] = 1;
+
+    opcode = rom[offset] << 8 | rom[offset + 1];
+    if (is_xo_chip_opcode(opcode))
+      return &xo_chip_core;
+    if (is_super_chip_opcode(opcode))
+      found = &super_chip_core;
+
+    switch (opcode & 0xF000) {
+    case 0x0000:
+      if (opcode != 0x00EE)
+        next[targets++] = addr + 2;
+      break;
+    case 0x1000:
+      next[targets++] = opcode & 0xFFF;
+      break;
+    case 0x2000:
+      next[targets++] = opcode & 0xFFF;
+      next[targets++] = addr + 2;
+      break;
+    case 0x3000:
+    case 0x4000:
+    case 0x5000:
+    case 0x9000:
+    case 0xE000:
+      next[targets++] = addr + 2;
+      next[targets++] = addr + 4;
+      break;
+    case 0xB000:
+      break;
+    default:
+      next[targets++] = addr + 2;
+      break;
+    }
 
-static void opcode_8xy4(CHIP8 chip) {
-  uint8_t x = (uint8_t)(chip->opcode >> 8 & 0xF);
-  uint8_t y = (uint8_t)(chip->opcode >> 4 & 0xF);
+    for (size_t i = 0; i < targets && count < MAX_TRACE; i++)
+      pending[count++] = next[i];
+  }
 
-  uint8_t vf = 255 - chip->regs[x] < chip->regs[y] ? 1 : 0;
-  chip->regs[x] += chip->regs[y];
-  chip->regs[0xF] = vf;
+  return found;
 }
 
-static void opcode_8xy5(CHIP8 chip) {
-  uint8_t x = (uint8_t)(chip->opcode >> 8 & 0xF);
-  uint8_t y = (uint8_t)(chip->opcode >> 4 & 0xF);
-
-  uint8_t vf = chip->regs[x] >= chip->regs[y] ? 1 : 0;
-  chip->regs[x] -= chip->regs[y];
-  chip->regs[0xF] = vf;
+CHIP8 chip_init(ChipConfig conf) {
+  if (conf.core == NULL)
+    conf.core = &chip8_core;
+  return conf.core->init(conf);
 }
 
-static void opcode_8xy6(CHIP8 chip) {
-  uint8_t x = (uint8_t)(chip->opcode >> 8 & 0xF);
-  uint8_t vf;
+void chip_destroy(CHIP8 chip) { core(chip)->destroy(chip); }
 
-  if (!(chip->quirks & SHIFTING)) {
-    uint8_t y = (uint8_t)(chip->opcode >> 4 & 0xF);
-    chip->regs[x] = chip->regs[y];
-  }
+void chip_run_cycle(CHIP8 chip) { core(chip)->run_cycles(chip, 1); }
 
-  vf = chip->regs[x] & 0x1;
-  chip->regs[x] >>= 1;
-  chip->regs[0xF] = vf;
+uint32_t chip_run_cycles(CHIP8 chip, uint32_t cycles) {
+  return core(chip)->run_cycles(chip, cycles);
 }
 
-static void opcode_8xy7(CHIP8 chip) {
-  uint8_t x = (uint8_t)(chip->opcode >> 8 & 0xF);
-  uint8_t y = (uint8_t)(chip->opcode >> 4 & 0xF);
+void chip_update_timers(CHIP8 chip) { core(chip)->update_timers(chip); }
 
-  uint8_t vf = chip->regs[y] >= chip->regs[x] ? 1 : 0;
-  chip->regs[x] = chip->regs[y] - chip->regs[x];
-  chip->regs[0xF] = vf;
+bool chip_is_sound_timer_active(CHIP8 chip) {
+  return core(chip)->is_sound_timer_active(chip);
 }
 
-static void opcode_8xyE(CHIP8 chip) {
-  uint8_t x = (uint8_t)(chip->opcode >> 8 & 0xF);
-  uint8_t vf;
-
-  if (!(chip->quirks & SHIFTING)) {
-    uint8_t y = (uint8_t)(chip->opcode >> 4 & 0xF);
-    chip->regs[x] = chip->regs[y];
-  }
+uint64_t chip_get_cycle(CHIP8 chip) { return core(chip)->get_cycle(chip); }
 
-  vf = (chip->regs[x] >> 7) & 0x1;
-  chip->regs[x] <<= 1;
-  chip->regs[0xF] = vf;
+size_t chip_take_sound_events(CHIP8 chip, ChipSoundEvent *events) {
+  return core(chip)->take_sound_events(chip, events);
 }
 
-static void opcode_Annn(CHIP8 chip) { chip->index = chip->opcode & 0xFFF; }
-
-static void opcode_Bnnn(CHIP8 chip) {
-  uint8_t x = 0x0;
-
-  if (chip->quirks & JUMPING)
-    x = (uint8_t)(chip->opcode >> 8 & 0xF);
+const char *chip_backend_name(CHIP8 chip) { return core(chip)->name; }
+ChipStatus chip_get_status(CHIP8 chip) { return core(chip)->get_status(chip); }
+uint16_t chip_get_pc(CHIP8 chip) { return core(chip)->get_pc(chip); }
 
-  chip->pc = (chip->opcode & 0xFFF) + chip->regs[x];
+void chip_load_rom(CHIP8 chip, const uint8_t *rom, size_t size) {
+  core(chip)->load_rom(chip, rom, size);
 }
 
-static void opcode_Cxkk(CHIP8 chip) {
-  uint8_t rv = (uint8_t)(rand() / (RAND_MAX / 256));
-  uint8_t x = (uint8_t)(chip->opcode >> 8) & 0xF;
-  uint8_t value = (uint8_t)(chip->opcode & 0xFF);
-
-  chip->regs[x] = rv & value;
+void chip_kb_btn_pressed(CHIP8 chip, uint8_t key) {
+  core(chip)->update_input(chip, chip_get_input(chip) | 1 << key, key);
 }
 
-static void opcode_Dxyn(CHIP8 chip) {
-  uint8_t vx = chip->regs[(uint8_t)(chip->opcode >> 8 & 0xF)];
-  uint8_t vy = chip->regs[(uint8_t)(chip->opcode >> 4 & 0xF)];
-
-  uint8_t screen_width = chip->screen_width;
-  uint8_t screen_height = chip->screen_height;
-  uint8_t x = vx & (screen_width - 1);
-  uint8_t y = vy & (screen_height - 1);
-
-  uint16_t posx = 0, posy = 0, rows = chip->opcode & 0xF;
-  uint8_t sprite_data;
-
-  chip->regs[0xF] = 0;
-  for (uint16_t row = 0; row < rows; row++) {
-    sprite_data = chip->mem[chip->index + row];
-
-    posy = y + row;
-
-    if (posy > (screen_height - 1)) {
-      if (chip->quirks & CLIPPING)
-        continue;
-      else
-        posy %= screen_height;
-    }
-
-    for (uint8_t col = 0; col < SPRITE_SIZE; col++) {
-      posx = x + col;
-
-      if (posx > (screen_width - 1)) {
-        if (chip->quirks & CLIPPING)
-          continue;
-        else
-          posx %= screen_width;
-      }
-
-      if (sprite_data & 1 << (SPRITE_SIZE - 1 - col)) {
-        set_vram_data_at_pos(chip, posx, posy, false);
-      }
-    }
-  }
+void chip_kb_btn_released(CHIP8 chip, uint8_t key) {
+  core(chip)->update_input(chip, chip_get_input(chip) & ~(1 << key),
+                           chip_get_input_key(chip));
 }
 
-static void opcode_Ex9E(CHIP8 chip) {
-  uint8_t x = (uint8_t)(chip->opcode >> 8 & 0xF);
-  uint8_t vx = chip->regs[x] & 0xF;
-
-  if (chip->input & (1 << vx))
-    chip->pc += 2;
+void chip_update_input(CHIP8 chip, uint16_t input, uint8_t key) {
+  core(chip)->update_input(chip, input, key);
 }
 
-static void opcode_ExA1(CHIP8 chip) {
-  uint8_t x = (uint8_t)(chip->opcode >> 8 & 0xF);
-  uint8_t vx = chip->regs[x] & 0xF;
+uint16_t chip_get_input(CHIP8 chip) { return core(chip)->get_input(chip); }
 
-  if (!(chip->input & (1 << vx)))
-    chip->pc += 2;
+uint8_t chip_get_input_key(CHIP8 chip) {
+  return core(chip)->get_input_key(chip);
 }
 
-static void opcode_Fx07(CHIP8 chip) {
-  uint8_t x = (uint8_t)(chip->opcode >> 8 & 0xF);
-  chip->regs[x] = chip->dt;
+const uint64_t *chip_get_vram_rows(CHIP8 chip) {
+  return core(chip)->get_vram_rows(chip);
 }
 
-static void opcode_Fx0A(CHIP8 chip) {
-  if (chip->input) {
-    uint8_t x = (uint8_t)(chip->opcode >> 8 & 0xF);
-    chip->regs[x] = chip->input_key;
-  } else {
-    chip->pc -= 2;
-  }
+uint8_t chip_get_screen_width(CHIP8 chip) { return core(chip)->screen_width; }
+uint8_t chip_get_screen_height(CHIP8 chip) {
+  return core(chip)->screen_height;
 }
 
-static void opcode_Fx15(CHIP8 chip) {
-  uint8_t x = (uint8_t)(chip->opcode >> 8 & 0xF);
-  chip->dt = chip->regs[x];
-}
+uint8_t chip_get_planes(CHIP8 chip) { return core(chip)->planes; }
 
-static void opcode_Fx18(CHIP8 chip) {
-  uint8_t x = (uint8_t)(chip->opcode >> 8 & 0xF);
-  chip->st = chip->regs[x];
+/* Whether a rom of size bytes fits into the memory of a core. */
+bool chip_rom_fits(const ChipCore *target, size_t size) {
+  return size <= target->mem_size - START_ADDRESS;
 }
 
-static void opcode_Fx29(CHIP8 chip) {
-  uint8_t x = (uint8_t)(chip->opcode >> 8 & 0xF);
-  chip->index = (chip->regs[x] & 0xF) * 5;
+uint32_t chip_get_vram_generation(CHIP8 chip) {
+  return core(chip)->get_vram_generation(chip);
 }
 
-static void opcode_Fx33(CHIP8 chip) {
-  uint8_t x = (uint8_t)(chip->opcode >> 8 & 0xF);
-  uint8_t i = 3;
-  uint8_t vx = chip->regs[x];
-
-  while (i) {
-    chip->mem[chip->index + i - 1] = vx % 10;
-    i--;
-    vx /= 10;
-  }
+uint64_t chip_take_dirty_rows(CHIP8 chip) {
+  return core(chip)->take_dirty_rows(chip);
 }
 
-static void opcode_Fx55(CHIP8 chip) {
-  uint8_t x = (uint8_t)(chip->opcode >> 8 & 0xF);
-
-  for (int i = 0; i <= x; i++)
-    chip->mem[chip->index + i] = chip->regs[i];
-
-  if (chip->quirks & MEMORY)
-    chip->index += x + 1;
+void chip_get_frame(CHIP8 chip, ChipFrame *frame) {
+  core(chip)->get_frame(chip, frame);
 }
 
-static void opcode_Fx65(CHIP8 chip) {
-  uint8_t x = (uint8_t)(chip->opcode >> 8 & 0xF);
-
-  for (int i = 0; i <= x; i++)
-    chip->regs[i] = chip->mem[chip->index + i];
-
-  if (chip->quirks & MEMORY)
-    chip->index += x + 1;
+void chip_save_state(CHIP8 chip, ChipState *state) {
+  core(chip)->save_state(chip, state);
 }
 
-static void opcode_Fx1E(CHIP8 chip) {
-  uint8_t x = (uint8_t)(chip->opcode >> 8 & 0xF);
-  chip->index += chip->regs[x];
+bool chip_load_state(CHIP8 chip, const ChipState *state) {
+  return core(chip)->load_state(chip, state);
 }
 
-static void opcode_nop(CHIP8 chip) {}
-
-static void fetch(CHIP8 chip) {
-  uint16_t op_h, op_l;
-
-  op_h = chip->mem[chip->pc] << 8;
-  op_l = chip->mem[chip->pc + 1];
-  chip->opcode = op_h | op_l;
-  chip->pc += 2;
+void chip_set_quirks(CHIP8 chip, uint8_t quirks) {
+  core(chip)->set_quirks(chip, quirks);
 }
 
-static void decode(CHIP8 chip) {
-  switch (chip->opcode & 0xF000) {
-  case 0x0000:
-    switch (chip->opcode & 0x00FF) {
-    case 0x00E0:
-      chip->exec = &opcode_00E0;
-      break;
-    case 0x00EE:
-      chip->exec = &opcode_00EE;
-      break;
-    default:
-      chip->exec = &opcode_nop;
-      break;
-    }
-    break;
-  case 0x1000:
-    chip->exec = &opcode_1xxx;
-    break;
-  case 0x2000:
-    chip->exec = &opcode_2nnn;
-    break;
-  case 0x3000:
-    chip->exec = &opcode_3xkk;
-    break;
-  case 0x4000:
-    chip->exec = &opcode_4xkk;
-    break;
-  case 0x5000:
-    chip->exec = (chip->opcode & 0xF) == 0 ? &opcode_5xy0 : &opcode_nop;
-    break;
-  case 0x6000:
-    chip->exec = &opcode_6xkk;
-    break;
-  case 0x7000:
-    chip->exec = &opcode_7xkk;
-    break;
-  case 0x8000: {
-    switch (chip->opcode & 0xF) {
-    case 0x0:
-      chip->exec = &opcode_8xy0;
-      break;
-    case 0x1:
-      chip->exec = &opcode_8xy1;
-      break;
-    case 0x2:
-      chip->exec = &opcode_8xy2;
-      break;
-    case 0x3:
-      chip->exec = &opcode_8xy3;
-      break;
-    case 0x4:
-      chip->exec = &opcode_8xy4;
-      break;
-    case 0x5:
-      chip->exec = &opcode_8xy5;
-      break;
-    case 0x6:
-      chip->exec = &opcode_8xy6;
-      break;
-    case 0x7:
-      chip->exec = &opcode_8xy7;
-      break;
-    case 0xE:
-      chip->exec = &opcode_8xyE;
-      break;
-    default:
-      chip->exec = &opcode_unsupported;
-    }
-    break;
-  }
-  case 0x9000:
-    chip->exec = (chip->opcode & 0xF) == 0 ? &opcode_9xy0 : &opcode_nop;
-    break;
-  case 0xA000:
-    chip->exec = &opcode_Annn;
-    break;
-  case 0xB000:
-    chip->exec = &opcode_Bnnn;
-    break;
-  case 0xC000:
-    chip->exec = &opcode_Cxkk;
-    break;
-  case 0xD000:
-    chip->exec = &opcode_Dxyn;
-    break;
-  case 0xE000:
-    switch (chip->opcode & 0xFF) {
-    case 0x009E:
-      chip->exec = &opcode_Ex9E;
-      break;
-    case 0x00A1:
-      chip->exec = &opcode_ExA1;
-      break;
-    default:
-      chip->exec = &opcode_unsupported;
-      break;
-    }
-    break;
-  case 0xF000:
-    switch (chip->opcode & 0xFF) {
-    case 0x0007:
-      chip->exec = &opcode_Fx07;
-      break;
-    case 0x000A:
-      chip->exec = &opcode_Fx0A;
-      break;
-    case 0x0015:
-      chip->exec = &opcode_Fx15;
-      break;
-    case 0x0018:
-      chip->exec = &opcode_Fx18;
-      break;
-    case 0x001E:
-      chip->exec = &opcode_Fx1E;
-      break;
-    case 0x0029:
-      chip->exec = &opcode_Fx29;
-      break;
-    case 0x0033:
-      chip->exec = &opcode_Fx33;
-      break;
-    case 0x0055:
-      chip->exec = &opcode_Fx55;
-      break;
-    case 0x0065:
-      chip->exec = &opcode_Fx65;
-      break;
-    default:
-      chip->exec = &opcode_unsupported;
-      break;
-    }
-    break;
-  default:
-    chip->exec = &opcode_unsupported;
-    break;
-  }
+/* NULL unless the core was built with CHIP_PROFILE. */
+const ChipProfile *chip_get_profile(CHIP8 chip) {
+  return core(chip)->get_profile(chip);
 }
-
-static void execute(CHIP8 chip) { chip->exec(chip); }
@@ -8,10 +8,20 @@
 #define SCREEN_WIDTH 64
 #define SCREEN_HEIGHT 32
 #define MEM_SIZE 0x1000
-#define VRAM_SIZE 0x0800
+#define XO_MEM_SIZE 0x10000
+#define ROM_MAX_SIZE (XO_MEM_SIZE - START_ADDRESS)
+#define VRAM_WORD_BITS 64
+#define VRAM_SIZE (SCREEN_WIDTH * SCREEN_HEIGHT / VRAM_WORD_BITS)
+#define FRAME_SIZE (VRAM_SIZE << 2)
+#define FRAME_PLANES 2
 #define START_ADDRESS 0x0200
 #define REGS_COUNT 16
 #define SPRITE_SIZE 8
+#define AUDIO_PATTERN_SIZE 16
+#define AUDIO_DEFAULT_PITCH 64
+#define SOUND_EVENTS 16
+#define STATE_STACK_SIZE 16
+#define PROFILE_OPS 64
 
 typedef enum {
   VF_RESET = 1,
@@ -21,23 +31,201 @@ typedef enum {
   SHIFTING = 16,
   JUMPING = 32
 } InstrQuirk;
+typedef enum {
+  CHIP_RUNNING,
+  CHIP_EXITED,
+  CHIP_UNSUPPORTED_OPCODE,
+  CHIP_STACK_OVERFLOW,
+  CHIP_WAITING_VBLANK
+} ChipStatus;
 typedef struct chip8 *CHIP8;
+typedef struct ChipCore ChipCore;
 typedef struct ChipConfig {
   uint8_t quirks;
+  uint64_t seed;
+  /* The core to run, chip8_core when NULL. */
+  const ChipCore *core;
 } ChipConfig;
 
+/*
+ * The XO-CHIP sound: a 128 bit pattern played one bit at a time, at
+ * 4000 * 2^((pitch - 64) / 48) bits per second. Until a pattern is loaded
+ * the sound timer plays the plain buzzer.
+ */
+typedef struct ChipAudio {
+  uint8_t pattern[AUDIO_PATTERN_SIZE];
+  uint8_t pitch;
+  bool pattern_loaded;
+} ChipAudio;
+
+/*
+ * A change of the sound output: the sound timer starting or running out, or
+ * a new pattern or pitch. cycle is the chip cycle it took effect after, see
+ * chip_get_cycle. Each event holds the whole sound state.
+ */
+typedef struct ChipSoundEvent {
+  uint64_t cycle;
+  bool on;
+  ChipAudio audio;
+} ChipSoundEvent;
+
+/*
+ * A copy of the screen that can be read while the chip keeps running. Large
+ * enough for any core. It holds planes bit planes, one after the other, see
+ * vram_color. dirty_rows holds the rows changed since the previous frame
+ * taken from the same chip.
+ */
+typedef struct ChipFrame {
+  uint64_t vram[FRAME_PLANES * FRAME_SIZE];
+  uint8_t screen_width;
+  uint8_t screen_height;
+  uint8_t planes;
+  uint32_t vram_generation;
+  uint64_t dirty_rows;
+} ChipFrame;
+
+/*
+ * Execution counters of a core built with CHIP_PROFILE: instructions run per
+ * handler, named by op_names, and per address, plus the memory bytes read
+ * and written by the sprite and register load/store instructions.
+ */
+typedef struct ChipProfile {
+  const char *const *op_names;
+  uint8_t op_count;
+  uint64_t ops[PROFILE_OPS];
+  uint64_t pcs[MEM_SIZE];
+  uint64_t reads[MEM_SIZE];
+  uint64_t writes[MEM_SIZE];
+} ChipProfile;
+
+/*
+ * Everything needed to resume a chip, for any core, in a fixed layout that
+ * is written to save state files as is. Fields and memory a core doesn't
+ * have are left zero.
+ */
+typedef struct ChipState {
+  uint64_t rng;
+  uint64_t cycle;
+  uint64_t vram[FRAME_PLANES * FRAME_SIZE];
+  uint8_t mem[XO_MEM_SIZE];
+  uint16_t stack[STATE_STACK_SIZE];
+  uint16_t pc;
+  uint16_t index;
+  uint16_t input;
+  uint8_t regs[REGS_COUNT];
+  uint8_t sp;
+  uint8_t dt;
+  uint8_t st;
+  uint8_t input_key;
+  uint8_t quirks;
+  uint8_t status;
+  uint8_t vblank;
+  uint8_t hires;
+  uint8_t screen_width;
+  uint8_t screen_height;
+  uint8_t planes;
+  uint8_t selected_planes;
+  ChipAudio audio;
+} ChipState;
+
+/*
+ * A core implements one platform, each built from chip-core.h with its
+ * screen geometry as compile-time constants. Every machine starts with a
+ * pointer to its core, and the chip_* functions dispatch through it once
+ * per call, so the instruction loops of a core never see the table.
+ */
+struct ChipCore {
+  const char *name;
+  CHIP8 (*init)(ChipConfig);
+  void (*destroy)(CHIP8);
+  uint32_t (*run_cycles)(CHIP8, uint32_t);
+  void (*update_timers)(CHIP8);
+  bool (*is_sound_timer_active)(CHIP8);
+  uint64_t (*get_cycle)(CHIP8);
+  size_t (*take_sound_events)(CHIP8, ChipSoundEvent *);
+  ChipStatus (*get_status)(CHIP8);
+  uint16_t (*get_pc)(CHIP8);
+  void (*load_rom)(CHIP8, const uint8_t *, size_t);
+  void (*update_input)(CHIP8, uint16_t, uint8_t);
+  uint16_t (*get_input)(CHIP8);
+  uint8_t (*get_input_key)(CHIP8);
+  const uint64_t *(*get_vram_rows)(CHIP8);
+  uint8_t screen_width;
+  uint8_t screen_height;
+  uint8_t planes;
+  uint32_t mem_size;
+  uint32_t (*get_vram_generation)(CHIP8);
+  uint64_t (*take_dirty_rows)(CHIP8);
+  void (*get_frame)(CHIP8, ChipFrame *);
+  void (*save_state)(CHIP8, ChipState *);
+  bool (*load_state)(CHIP8, const ChipState *);
+  void (*set_quirks)(CHIP8, uint8_t);
+  const ChipProfile *(*get_profile)(CHIP8);
+};
+
+extern const ChipCore chip8_core;
+extern const ChipCore super_chip_core;
+extern const ChipCore xo_chip_core;
+
+const ChipCore *chip_find_core(const char *);
+const ChipCore *chip_detect_core(const uint8_t *, size_t);
 CHIP8 chip_init(ChipConfig);
 void chip_destroy(CHIP8);
 void chip_run_cycle(CHIP8);
+uint32_t chip_run_cycles(CHIP8, uint32_t);
 void chip_update_timers(CHIP8);
 bool chip_is_sound_timer_active(CHIP8);
-void chip_load_rom(CHIP8, uint8_t *, size_t);
+uint64_t chip_get_cycle(CHIP8);
+size_t chip_take_sound_events(CHIP8, ChipSoundEvent *);
+const char *chip_backend_name(CHIP8);
+ChipStatus chip_get_status(CHIP8);
+uint16_t chip_get_pc(CHIP8);
+void chip_load_rom(CHIP8, const uint8_t *, size_t);
 void chip_kb_btn_pressed(CHIP8, uint8_t);
 void chip_kb_btn_released(CHIP8, uint8_t);
 void chip_update_input(CHIP8, uint16_t, uint8_t);
-uint8_t *chip_get_vram_ref(CHIP8);
+uint16_t chip_get_input(CHIP8);
+uint8_t chip_get_input_key(CHIP8);
+const uint64_t *chip_get_vram_rows(CHIP8);
 uint8_t chip_get_screen_width(CHIP8);
 uint8_t chip_get_screen_height(CHIP8);
+uint8_t chip_get_planes(CHIP8);
+bool chip_rom_fits(const ChipCore *, size_t);
+uint32_t chip_get_vram_generation(CHIP8);
+uint64_t chip_take_dirty_rows(CHIP8);
+void chip_get_frame(CHIP8, ChipFrame *);
+void chip_save_state(CHIP8, ChipState *);
+bool chip_load_state(CHIP8, const ChipState *);
+void chip_set_quirks(CHIP8, uint8_t);
+const ChipProfile *chip_get_profile(CHIP8);
+
+/*
+ * The frame is one bit per pixel, screen_width / 64 words per row, with the
+ * leftmost pixel of a word in its most significant bit.
+ */
+static inline bool vram_pixel(const uint64_t *rows, uint8_t width, uint8_t x,
+                              uint8_t y) {
+  size_t pitch = width / VRAM_WORD_BITS;
+
+  return rows[y * pitch + x / VRAM_WORD_BITS] >>
+             (VRAM_WORD_BITS - 1 - x % VRAM_WORD_BITS) &
+         1;
+}
+
+/*
+ * The palette index of a pixel, bit n being set when the pixel is lit on
+ * plane n. Planes follow each other, width * height bits apart.
+ */
+static inline uint8_t vram_color(const uint64_t *rows, uint8_t planes,
+                                 uint8_t width, uint8_t height, uint8_t x,
+                                 uint8_t y) {
+  size_t plane_words = (size_t)width * height / VRAM_WORD_BITS;
+  uint8_t color = 0;
+
+  for (uint8_t p = 0; p < planes; p++)
+    color |= vram_pixel(rows + p * plane_words, width, x, y) << p;
+  return color;
+}
 
 static const uint8_t font[80] = {
     0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
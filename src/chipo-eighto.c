@@ -1,18 +1,29 @@
 #include "args.h"
 #include "chip.h"
 #include "config.h"
+#include "emu.h"
 #include "media.h"
+#include "movie.h"
+#include "profile.h"
+#include "rewind.h"
+#include "romdb.h"
+#include "state.h"
 #include "sys.h"
 #include "utils.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
+
+#define AUDIO_BUFFER_MIN 64
+#define AUDIO_BUFFER_MAX 4096
+#define TIMER_HZ 60
 
 Config *parse_args_into_config(int argc, char **argv) {
   Config *config = config_init();
 
-  ArgParserOptions *options = args_init_options(4);
+  ArgParserOptions *options = args_init_options(18);
   args_add_options(
-      options, 4,
+      options, 18,
       (ArgParserOption){.lng = "bg",
                         .shrt = 'b',
                         .description =
@@ -27,6 +38,35 @@ Config *parse_args_into_config(int argc, char **argv) {
                             "255,255,255,255. Default: 0,238,0,255",
                         .parse = &parse_color_arg_value,
                         .set = &config_set_foreground},
+      (ArgParserOption){.lng = "fg2",
+                        .shrt = 'g',
+                        .description =
+                            "rgba color for pixels lit on the second XO-CHIP "
+                            "plane only. Default: 238,102,0,255",
+                        .parse = &parse_color_arg_value,
+                        .set = &config_set_foreground2},
+      (ArgParserOption){.lng = "blend",
+                        .shrt = 'd',
+                        .description =
+                            "rgba color for pixels lit on both XO-CHIP "
+                            "planes. Default: 238,238,0,255",
+                        .parse = &parse_color_arg_value,
+                        .set = &config_set_blend},
+      (ArgParserOption){.lng = "renderer",
+                        .shrt = 'r',
+                        .description =
+                            "how the screen is drawn: texture uploads one "
+                            "image per frame, rects draws a rectangle per "
+                            "pixel. Default: texture",
+                        .parse = &parse_renderer_arg_value,
+                        .set = &config_set_renderer},
+      (ArgParserOption){.lng = "core",
+                        .shrt = 'k',
+                        .description = "core to run the rom on: chip-8, "
+                                       "super-chip or xo-chip. Default: "
+                                       "picked from the rom",
+                        .parse = &parse_core_arg_value,
+                        .set = &config_set_core},
       (ArgParserOption){
           .lng = "quirk",
           .shrt = 'q',
@@ -38,7 +78,8 @@ Config *parse_args_into_config(int argc, char **argv) {
               "instructions\n"
               "\t\t\t\tmemory   - don't modify index register for FX55, FX65 "
               "instructions\n"
-              "\t\t\t\tdisplay  - limiting sprites drawing by 60 per frame\n"
+              "\t\t\t\tdisplay  - wait for the vertical blank before drawing "
+              "a sprite, lores only on Super-Chip\n"
               "\t\t\t\tclipping - clip sprites instead of wrapping around to "
               "the top of the screen\n"
               "\t\t\t\tshifting - ignore VY register and 8XY6, 8XYE "
@@ -47,6 +88,65 @@ Config *parse_args_into_config(int argc, char **argv) {
               "BNNN instruction",
           .parse = &parse_chip_quirk_arg_value,
           .set = &config_set_chip_quirks},
+      (ArgParserOption){.lng = "seed",
+                        .shrt = 's',
+                        .description = "seed for the random number generator. "
+                                       "Default: current time",
+                        .parse = &parse_uint_arg_value,
+                        .set = &config_set_seed},
+      (ArgParserOption){.lng = "hz",
+                        .shrt = 'z',
+                        .description = "instructions per second. Default: 1200",
+                        .parse = &parse_uint_arg_value,
+                        .set = &config_set_hz},
+      (ArgParserOption){.lng = "audio-buffer",
+                        .shrt = 'a',
+                        .description = "audio buffer size in frames, from "
+                                       "64 to 4096. Default: 512",
+                        .parse = &parse_uint_arg_value,
+                        .set = &config_set_audio_buffer},
+      (ArgParserOption){.lng = "slot",
+                        .shrt = 'l',
+                        .description = "save state slot used by the [ and ] "
+                                       "keys and --resume. Default: 1",
+                        .parse = &parse_uint_arg_value,
+                        .set = &config_set_slot},
+      (ArgParserOption){.lng = "resume",
+                        .shrt = 'u',
+                        .description = "load the save state slot on start "
+                                       "and save it again on exit",
+                        .parse = NULL,
+                        .set = &config_set_resume},
+      (ArgParserOption){.lng = "rewind",
+                        .shrt = 'w',
+                        .description = "memory for the rewind history in "
+                                       "KiB, 0 turns it off. Default: 4096",
+                        .parse = &parse_uint_arg_value,
+                        .set = &config_set_rewind_size},
+      (ArgParserOption){.lng = "record",
+                        .shrt = 'm',
+                        .description = "record the input to a movie file",
+                        .parse = &parse_string_arg_value,
+                        .set = &config_set_record},
+      (ArgParserOption){.lng = "replay",
+                        .shrt = 'e',
+                        .description = "replay the input of a movie file, "
+                                       "with the core, quirks, seed and "
+                                       "speed it was recorded with",
+                        .parse = &parse_string_arg_value,
+                        .set = &config_set_replay},
+      (ArgParserOption){.lng = "cpu",
+                        .shrt = 'c',
+                        .description = "pin the emulation thread to a cpu",
+                        .parse = &parse_uint_arg_value,
+                        .set = &config_set_cpu},
+      (ArgParserOption){.lng = "db",
+                        .shrt = 'x',
+                        .description = "rom database to take the core, "
+                                       "quirks, speed and keys of the rom "
+                                       "from",
+                        .parse = &parse_string_arg_value,
+                        .set = &config_set_db},
       (ArgParserOption){.lng = "help",
                         .shrt = 'h',
                         .description = "display this help and exit",
@@ -59,45 +159,169 @@ Config *parse_args_into_config(int argc, char **argv) {
   return config;
 }
 
+/* How much play the history held on exit and what it cost per minute. */
+static void print_rewind_stats(RewindStats stats) {
+  if (stats.frames == 0)
+    return;
+
+  printf("Rewind: %.1f s in %zu of %zu KiB, %zu KiB per minute, "
+         "%.1f us per frame\n",
+         stats.frames / 60.0, stats.bytes / 1024, stats.budget / 1024,
+         stats.bytes * 3600 / stats.frames / 1024, stats.push_time * 1e6);
+}
+
 int main(int argc, char **argv) {
   Config *config = parse_args_into_config(argc, argv);
 
   RomData rd = read_rom_file(argv[1]);
-  printf("Loading rom %s (%ld)\n", argv[1], rd.size);
+  uint64_t rom_hash = hash_bytes(rd.data, rd.size);
+  printf("Loading rom %s (%ld, hash %016llx)\n", argv[1], rd.size,
+         (unsigned long long)rom_hash);
+
+  if (config->db != NULL) {
+    bool found;
+    const char *db_error =
+        romdb_configure(config->db, rom_hash, config, &found);
+
+    if (db_error != NULL)
+      terminate(db_error);
+    if (found)
+      printf("Rom found in %s\n", config->db);
+  }
+
+  if (!config->seed_set)
+    config->seed = (uint64_t)time(NULL);
+
+  if (config->audio_buffer &&
+      (config->audio_buffer < AUDIO_BUFFER_MIN ||
+       config->audio_buffer > AUDIO_BUFFER_MAX))
+    terminate("The audio buffer must be 64 to 4096 frames");
 
   SYS *sys = sys_init();
-  CHIP8 chip = chip_init((ChipConfig){.quirks = config->chip_quirks});
+  if (config->hz)
+    sys->chip_freq = config->hz;
+  else if (config->cpf)
+    sys->chip_freq = config->cpf * TIMER_HZ;
+
+  if (config->record && config->replay)
+    terminate("--record and --replay can't be combined");
+
+  if (config->core == NULL)
+    config->core = chip_detect_core(rd.data, rd.size);
+
+  /* A movie starts from power-on, so it can't be rewound or resumed. */
+  MOVIE movie = NULL;
+  const char *movie_error = NULL;
+  MovieInfo minfo = {.seed = config->seed,
+                     .hz = sys->chip_freq,
+                     .quirks = config->chip_quirks,
+                     .core = config->core};
+
+  if (config->replay)
+    movie_error = movie_replay(config->replay, &rd, &minfo, &movie);
+  else if (config->record)
+    movie_error = movie_record(config->record, &rd, minfo, &movie);
+  if (movie_error != NULL)
+    terminate(movie_error);
+
+  if (movie != NULL) {
+    config->core = minfo.core;
+    config->chip_quirks = minfo.quirks;
+    config->seed = minfo.seed;
+    sys->chip_freq = minfo.hz;
+    config->rewind_size = 0;
+    config->resume = false;
+  }
+
+  if (!chip_rom_fits(config->core, rd.size))
+    terminate("Rom does not fit into the memory of the core");
+
+  printf("Core %s\n", config->core->name);
+  printf("Seed %llu\n", (unsigned long long)config->seed);
+
+  CHIP8 chip = chip_init((ChipConfig){.quirks = config->chip_quirks,
+                                      .seed = config->seed,
+                                      .core = config->core});
+  if (chip == NULL)
+    terminate("Failed to allocate memory");
   chip_load_rom(chip, rd.data, rd.size);
   free(rd.data);
 
+  char state_path[FILENAME_MAX];
+  char profile_path[FILENAME_MAX];
+  const char *state_error;
+
+  state_slot_path(state_path, sizeof(state_path), argv[1], config->slot);
+  profile_csv_path(profile_path, sizeof(profile_path), argv[1]);
+  if (config->resume) {
+    state_error = state_load(chip, state_path);
+    if (state_error == NULL)
+      printf("Resumed from %s\n", state_path);
+    else
+      printf("Starting fresh: %s\n", state_error);
+  }
+
+  AUDIO_QUEUE sound = audio_queue_init();
+  REWIND history =
+      config->rewind_size ? rewind_init((size_t)config->rewind_size * 1024)
+                          : NULL;
+
   MediaConfig mconfig = {.background_color = config->background,
-                         .foreground_color = config->foreground};
+                         .foreground_color = config->foreground,
+                         .foreground2_color = config->foreground2,
+                         .blend_color = config->blend,
+                         .renderer = config->renderer,
+                         .sound = sound,
+                         .audio_buffer = config->audio_buffer};
   MEDIA media = media_init(mconfig);
 
-  register_input_handlers(media, sys, chip);
+  EmuConfig econfig = {.sys = sys,
+                       .sound = sound,
+                       .state_path = state_path,
+                       .profile_path = profile_path,
+                       .rewind = history,
+                       .movie = movie,
+                       .pin = config->cpu_set,
+                       .cpu = config->cpu,
+                       .keys = config->keys_set ? config->keys : NULL};
+  EMU emu = emu_start(chip, econfig);
 
-  while (media_is_active(media)) {
-    while (sys_is_chip_active(sys)) {
-      chip_run_cycle(chip);
-    }
-    sys_reset_cycles(sys);
+  emu_register_input_handlers(emu, media);
+  register_hotkey_handlers(media, sys);
 
+  while (media_is_active(media) && emu_is_running(emu)) {
     media_start_drawing(media);
     media_read_input(media);
-    media_update_screen(media, chip);
+    media_update_screen(media, emu_acquire_frame(emu));
+    media_stop_drawing(media);
+  }
 
-    if (chip_is_sound_timer_active(chip)) {
-      media_play_sound(media);
-    } else {
-      media_pause_sound(media);
-    }
+  emu_stop(emu);
 
-    chip_update_timers(chip);
-    media_stop_drawing(media);
+  /* A machine that stopped would stop again right after resuming. */
+  if (config->resume && (chip_get_status(chip) == CHIP_RUNNING ||
+                         chip_get_status(chip) == CHIP_WAITING_VBLANK)) {
+    state_error = state_save(chip, state_path);
+    if (state_error != NULL)
+      printf("WARNING: %s\n", state_error);
+  }
+  if (chip_get_profile(chip) != NULL)
+    profile_dump(chip_get_profile(chip), profile_path);
+  if (movie != NULL) {
+    movie_error = movie_close(movie);
+    if (movie_error != NULL)
+      printf("WARNING: %s\n", movie_error);
+  }
+  check_chip_status(chip);
+
+  if (history != NULL) {
+    print_rewind_stats(rewind_get_stats(history));
+    rewind_destroy(history);
   }
 
   chip_destroy(chip);
   media_destroy(media);
+  audio_queue_destroy(sound);
   sys_destroy(sys);
   free(config);
 
@@ -10,7 +10,38 @@ Config *config_init() {
 
   config->background = (MediaColor){0, 0, 0, 255};
   config->foreground = (MediaColor){0, 238, 0, 255};
+  config->foreground2 = (MediaColor){238, 102, 0, 255};
+  config->blend = (MediaColor){238, 238, 0, 255};
+  config->renderer = RENDER_TEXTURE;
   config->chip_quirks = 0;
+  config->chip_quirks_set = false;
+  config->seed = 0;
+  config->seed_set = false;
+  config->frames = 0;
+  config->cycles = 0;
+  config->cpf = 0;
+  config->lanes = 0;
+  config->input_script = NULL;
+  config->threads = 0;
+  config->output = NULL;
+  config->cpu = 0;
+  config->cpu_set = false;
+  config->hz = 0;
+  config->audio_buffer = 0;
+  config->slot = 1;
+  config->resume = false;
+  config->rewind_size = 4096;
+  config->record = NULL;
+  config->replay = NULL;
+  config->reps = 0;
+  config->warmup = 0;
+  config->warmup_set = false;
+  config->baseline = NULL;
+  config->rom_dir = NULL;
+  config->pack = NULL;
+  config->db = NULL;
+  config->keys_set = false;
+  config->core = NULL;
 
   return config;
 }
@@ -25,7 +56,141 @@ void config_set_foreground(void *valp, void *confp) {
   conf->foreground = *(MediaColor *)valp;
 }
 
+void config_set_foreground2(void *valp, void *confp) {
+  Config *conf = (Config *)confp;
+  conf->foreground2 = *(MediaColor *)valp;
+}
+
+void config_set_blend(void *valp, void *confp) {
+  Config *conf = (Config *)confp;
+  conf->blend = *(MediaColor *)valp;
+}
+
+void config_set_renderer(void *valp, void *confp) {
+  Config *conf = (Config *)confp;
+  conf->renderer = *(MediaRenderer *)valp;
+}
+
 void config_set_chip_quirks(void *valp, void *confg) {
   Config *conf = (Config *)confg;
   conf->chip_quirks |= *(uint8_t *)valp;
+  conf->chip_quirks_set = true;
+}
+
+void config_set_seed(void *valp, void *confp) {
+  Config *conf = (Config *)confp;
+  conf->seed = *(unsigned long long *)valp;
+  conf->seed_set = true;
+}
+
+void config_set_frames(void *valp, void *confp) {
+  Config *conf = (Config *)confp;
+  conf->frames = *(unsigned long long *)valp;
+}
+
+void config_set_cycles(void *valp, void *confp) {
+  Config *conf = (Config *)confp;
+  conf->cycles = *(unsigned long long *)valp;
+}
+
+void config_set_cpf(void *valp, void *confp) {
+  Config *conf = (Config *)confp;
+  conf->cpf = *(unsigned long long *)valp;
+}
+
+void config_set_lanes(void *valp, void *confp) {
+  Config *conf = (Config *)confp;
+  conf->lanes = *(unsigned long long *)valp;
+}
+
+void config_set_input_script(void *valp, void *confp) {
+  Config *conf = (Config *)confp;
+  conf->input_script = *(char **)valp;
+}
+
+void config_set_threads(void *valp, void *confp) {
+  Config *conf = (Config *)confp;
+  conf->threads = *(unsigned long long *)valp;
+}
+
+void config_set_output(void *valp, void *confp) {
+  Config *conf = (Config *)confp;
+  conf->output = *(char **)valp;
+}
+
+void config_set_cpu(void *valp, void *confp) {
+  Config *conf = (Config *)confp;
+  conf->cpu = *(unsigned long long *)valp;
+  conf->cpu_set = true;
+}
+
+void config_set_hz(void *valp, void *confp) {
+  Config *conf = (Config *)confp;
+  conf->hz = *(unsigned long long *)valp;
+}
+
+void config_set_audio_buffer(void *valp, void *confp) {
+  Config *conf = (Config *)confp;
+  conf->audio_buffer = *(unsigned long long *)valp;
+}
+
+void config_set_slot(void *valp, void *confp) {
+  Config *conf = (Config *)confp;
+  conf->slot = *(unsigned long long *)valp;
+}
+
+void config_set_resume(void *valp, void *confp) {
+  Config *conf = (Config *)confp;
+  conf->resume = true;
+}
+
+void config_set_rewind_size(void *valp, void *confp) {
+  Config *conf = (Config *)confp;
+  conf->rewind_size = *(unsigned long long *)valp;
+}
+
+void config_set_record(void *valp, void *confp) {
+  Config *conf = (Config *)confp;
+  conf->record = *(char **)valp;
+}
+
+void config_set_replay(void *valp, void *confp) {
+  Config *conf = (Config *)confp;
+  conf->replay = *(char **)valp;
+}
+
+void config_set_reps(void *valp, void *confp) {
+  Config *conf = (Config *)confp;
+  conf->reps = *(unsigned long long *)valp;
+}
+
+void config_set_warmup(void *valp, void *confp) {
+  Config *conf = (Config *)confp;
+  conf->warmup = *(unsigned long long *)valp;
+  conf->warmup_set = true;
+}
+
+void config_set_baseline(void *valp, void *confp) {
+  Config *conf = (Config *)confp;
+  conf->baseline = *(char **)valp;
+}
+
+void config_set_rom_dir(void *valp, void *confp) {
+  Config *conf = (Config *)confp;
+  conf->rom_dir = *(char **)valp;
+}
+
+void config_set_pack(void *valp, void *confp) {
+  Config *conf = (Config *)confp;
+  conf->pack = *(char **)valp;
+}
+
+void config_set_db(void *valp, void *confp) {
+  Config *conf = (Config *)confp;
+  conf->db = *(char **)valp;
+}
+
+void config_set_core(void *valp, void *confp) {
+  Config *conf = (Config *)confp;
+  conf->core = *(const ChipCore **)valp;
 }
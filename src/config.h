@@ -1,19 +1,78 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#include "chip.h"
 #include "media.h"
 #include <stdlib.h>
 
 typedef struct Config {
   MediaColor background;
   MediaColor foreground;
+  MediaColor foreground2;
+  MediaColor blend;
+  MediaRenderer renderer;
   uint8_t chip_quirks;
+  bool chip_quirks_set;
+  uint64_t seed;
+  bool seed_set;
+  uint32_t frames;
+  uint64_t cycles;
+  uint16_t cpf;
+  uint8_t lanes;
+  char *input_script;
+  uint16_t threads;
+  char *output;
+  uint16_t cpu;
+  bool cpu_set;
+  uint32_t hz;
+  uint16_t audio_buffer;
+  uint16_t slot;
+  bool resume;
+  uint32_t rewind_size;
+  char *record;
+  char *replay;
+  uint32_t reps;
+  uint32_t warmup;
+  bool warmup_set;
+  char *baseline;
+  char *rom_dir;
+  char *pack;
+  char *db;
+  uint8_t keys[16];
+  bool keys_set;
+  const ChipCore *core;
 } Config;
 
 Config *config_init(void);
 
 void config_set_background(void *, void *);
 void config_set_foreground(void *, void *);
+void config_set_foreground2(void *, void *);
+void config_set_blend(void *, void *);
+void config_set_renderer(void *, void *);
 void config_set_chip_quirks(void *, void *);
+void config_set_seed(void *, void *);
+void config_set_frames(void *, void *);
+void config_set_cycles(void *, void *);
+void config_set_cpf(void *, void *);
+void config_set_lanes(void *, void *);
+void config_set_input_script(void *, void *);
+void config_set_threads(void *, void *);
+void config_set_output(void *, void *);
+void config_set_cpu(void *, void *);
+void config_set_hz(void *, void *);
+void config_set_audio_buffer(void *, void *);
+void config_set_slot(void *, void *);
+void config_set_resume(void *, void *);
+void config_set_rewind_size(void *, void *);
+void config_set_record(void *, void *);
+void config_set_replay(void *, void *);
+void config_set_reps(void *, void *);
+void config_set_warmup(void *, void *);
+void config_set_baseline(void *, void *);
+void config_set_rom_dir(void *, void *);
+void config_set_pack(void *, void *);
+void config_set_db(void *, void *);
+void config_set_core(void *, void *);
 
 #endif
@@ -2,42 +2,168 @@
 #include <stdlib.h>
 #include <string.h>
 
-HashTable *HashTable_create(size_t size) {
-  HashTable *ht = (HashTable *)malloc(sizeof(HashTable));
-  ht->size = size;
-  ht->table = malloc(size * sizeof(HTEntry *));
+#define ARENA_ALIGN 8
+#define ARENA_CHUNK_SIZE 65536
+#define HT_MIN_CAPACITY 16
+
+struct ArenaChunk {
+  ArenaChunk *next;
+  size_t size;
+  uint8_t data[];
+};
+
+void Arena_init(Arena *arena, size_t chunk_size) {
+  arena->chunks = NULL;
+  arena->used = 0;
+  arena->chunk_size = chunk_size ? chunk_size : ARENA_CHUNK_SIZE;
+}
+
+/* Returns NULL when a new chunk can't be allocated. */
+void *Arena_alloc(Arena *arena, size_t size) {
+  ArenaChunk *chunk = arena->chunks;
+
+  size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+  if (chunk == NULL || chunk->size - arena->used < size) {
+    size_t chunk_size = size > arena->chunk_size ? size : arena->chunk_size;
+
+    chunk = malloc(sizeof(ArenaChunk) + chunk_size);
+    if (chunk == NULL)
+      return NULL;
+    chunk->next = arena->chunks;
+    chunk->size = chunk_size;
+    arena->chunks = chunk;
+    arena->used = 0;
+  }
+
+  arena->used += size;
+  return chunk->data + arena->used - size;
+}
+
+void Arena_destroy(Arena *arena) {
+  while (arena->chunks != NULL) {
+    ArenaChunk *next = arena->chunks->next;
+
+    free(arena->chunks);
+    arena->chunks = next;
+  }
+  arena->used = 0;
+}
+
+/*
+ * Sized for the number of entries expected, so that many can be added
+ * without growing. Returns NULL when out of memory.
+ */
+HashTable *HashTable_create(size_t expected) {
+  HashTable *ht = malloc(sizeof(HashTable));
+  size_t capacity = HT_MIN_CAPACITY;
+
+  if (ht == NULL)
+    return NULL;
+
+  while (capacity / 4 * 3 < expected)
+    capacity *= 2;
+
+  ht->slots = calloc(capacity, sizeof(HTSlot));
+  if (ht->slots == NULL) {
+    free(ht);
+    return NULL;
+  }
+  ht->capacity = capacity;
+  ht->count = 0;
+  Arena_init(&ht->arena, 0);
 
   return ht;
 }
 
-size_t HashTable_hash(char *key, size_t size) {
-  size_t hashval;
+void HashTable_destroy(HashTable *ht) {
+  Arena_destroy(&ht->arena);
+  free(ht->slots);
+  free(ht);
+}
+
+/*
+ * 64-bit FNV-1a with a final mix, so the low bits used for the slot index
+ * depend on every byte. Never 0, which marks an empty slot.
+ */
+uint64_t HashTable_hash(const void *key, size_t size) {
+  const uint8_t *bytes = key;
+  uint64_t hash = 0xCBF29CE484222325ULL;
 
-  for (hashval = 0; *key != '\0'; key++)
-    hashval = *key + 31 * hashval;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001B3ULL;
+  }
 
-  return hashval % size;
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDULL;
+  hash ^= hash >> 33;
+
+  return hash ? hash : 1;
 }
 
-void HashTable_append(HashTable *ht, char *key, void *value) {
-  HTEntry *entry = malloc(sizeof(HTEntry));
-  entry->key = malloc(strlen(key) * sizeof(char));
-  strncpy(entry->key, key, strlen(key));
-  entry->value = value;
-  entry->next = NULL;
+static HTSlot *find_slot(const HashTable *ht, uint64_t hash, const void *key,
+                         size_t size) {
+  size_t mask = ht->capacity - 1;
 
-  size_t id = HashTable_hash(key, ht->size);
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    HTSlot *slot = &ht->slots[i];
 
-  ht->table[id] = entry;
+    if (slot->hash == 0 ||
+        (slot->hash == hash && slot->key_size == size &&
+         memcmp(slot->key, key, size) == 0))
+      return slot;
+  }
 }
 
-void *HashTable_get(HashTable *ht, char *key) {
-  unsigned id = HashTable_hash(key, ht->size);
+static bool grow(HashTable *ht) {
+  HTSlot *slots = calloc(ht->capacity * 2, sizeof(HTSlot));
+  HTSlot *old = ht->slots;
+  size_t capacity = ht->capacity;
 
-  HTEntry *entry;
+  if (slots == NULL)
+    return false;
 
-  if ((entry = ht->table[id]) == NULL)
-    return NULL;
+  ht->slots = slots;
+  ht->capacity *= 2;
+  for (size_t i = 0; i < capacity; i++)
+    if (old[i].hash != 0)
+      *find_slot(ht, old[i].hash, old[i].key, old[i].key_size) = old[i];
+
+  free(old);
+  return true;
+}
+
+/*
+ * Adds a key, copied into the arena, or replaces the value of a key that is
+ * already there. Returns false when out of memory.
+ */
+bool HashTable_put(HashTable *ht, const void *key, size_t size, void *value) {
+  uint64_t hash = HashTable_hash(key, size);
+  HTSlot *slot = find_slot(ht, hash, key, size);
+  void *copy;
+
+  if (slot->hash != 0) {
+    slot->value = value;
+    return true;
+  }
+
+  if (ht->count + 1 > ht->capacity / 4 * 3) {
+    if (!grow(ht))
+      return false;
+    slot = find_slot(ht, hash, key, size);
+  }
+
+  copy = Arena_alloc(&ht->arena, size);
+  if (copy == NULL)
+    return false;
+  memcpy(copy, key, size);
+
+  *slot = (HTSlot){.hash = hash, .key = copy, .key_size = size, .value = value};
+  ht->count++;
+  return true;
+}
 
-  return entry->value;
+/* Returns the value of a key, or NULL when it isn't in the table. */
+void *HashTable_get(const HashTable *ht, const void *key, size_t size) {
+  return find_slot(ht, HashTable_hash(key, size), key, size)->value;
 }
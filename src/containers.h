@@ -1,23 +1,49 @@
 #ifndef CONTAINERS_H
 #define CONTAINERS_H
 
-#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 
-typedef struct HTEntry {
-  char *key;
+/*
+ * A bump allocator: blocks are carved from large chunks and all freed at
+ * once by Arena_destroy. Allocations are 8 byte aligned.
+ */
+typedef struct ArenaChunk ArenaChunk;
+typedef struct Arena {
+  ArenaChunk *chunks;
+  size_t used;
+  size_t chunk_size;
+} Arena;
+
+void Arena_init(Arena *, size_t);
+void *Arena_alloc(Arena *, size_t);
+void Arena_destroy(Arena *);
+
+/*
+ * An open addressing hash map with linear probing over binary keys. Slots
+ * keep the full hash, so a probe only looks at other keys when the hashes
+ * match. Keys are copied into the table's arena, which values can be
+ * allocated from as well, so destroying the table frees everything at once.
+ */
+typedef struct HTSlot {
+  uint64_t hash;
+  const void *key;
+  size_t key_size;
   void *value;
-  struct HTEntry *next;
-} HTEntry;
+} HTSlot;
 
 typedef struct HashTable {
-  size_t size;
-  HTEntry **table;
+  HTSlot *slots;
+  size_t capacity;
+  size_t count;
+  Arena arena;
 } HashTable;
 
 HashTable *HashTable_create(size_t);
-size_t HashTable_hash(char *, size_t);
-void HashTable_append(HashTable *, char *, void *);
-void *HashTable_get(HashTable *, char *);
+void HashTable_destroy(HashTable *);
+uint64_t HashTable_hash(const void *, size_t);
+bool HashTable_put(HashTable *, const void *, size_t, void *);
+void *HashTable_get(const HashTable *, const void *, size_t);
 
 #endif
@@ -0,0 +1,405 @@
+#define _GNU_SOURCE
+
+#include "emu.h"
+#include "profile.h"
+#include "state.h"
+#include "utils.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NS_PER_SEC 1000000000LL
+#define TIMER_HZ 60
+#define TICK_NS (NS_PER_SEC / TIMER_HZ)
+#define MAX_CATCH_UP 6
+#define FRESH 4
+#define SAVE_STATE_KEY '['
+#define LOAD_STATE_KEY ']'
+#define REWIND_KEY 'B'
+#define PROFILE_KEY 'P'
+
+typedef enum { STATE_NONE, STATE_SAVE, STATE_LOAD } StateRequest;
+
+/*
+ * Triple buffer: the core writes frames[back], the renderer reads
+ * frames[front] and the third slot sits in middle. Publishing and taking a
+ * frame are a single atomic exchange of middle, whose FRESH bit tells the
+ * renderer that the slot holds a frame it hasn't seen yet.
+ */
+struct emu {
+  CHIP8 chip;
+  SYS *sys;
+  AUDIO_QUEUE sound;
+  const char *state_path;
+  const char *profile_path;
+  REWIND rewind;
+  MOVIE movie;
+  const uint8_t *keys;
+  pthread_t thread;
+
+  ChipFrame frames[3];
+  uint32_t seqs[3];
+  uint8_t back;
+  uint8_t middle;
+  uint8_t front;
+  uint32_t seq;
+  uint32_t front_seq;
+
+  int64_t origin;
+  uint64_t ticks;
+  uint32_t cycle_rest;
+
+  uint16_t input;
+  uint8_t input_key;
+  uint8_t state_request;
+  bool rewinding;
+  bool profile_request;
+  bool profiling;
+  bool stop;
+  bool running;
+};
+
+static void publish(EMU emu) {
+  uint8_t slot = emu->back;
+
+  chip_get_frame(emu->chip, &emu->frames[slot]);
+  emu->seqs[slot] = ++emu->seq;
+  emu->back =
+      __atomic_exchange_n(&emu->middle, slot | FRESH, __ATOMIC_ACQ_REL) & 3;
+}
+
+static int64_t now_ns(void) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * NS_PER_SEC + now.tv_nsec;
+}
+
+static void sleep_until(int64_t deadline) {
+  struct timespec t = {.tv_sec = deadline / NS_PER_SEC,
+                       .tv_nsec = deadline % NS_PER_SEC};
+
+  clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL);
+}
+
+/* Start of the given 60 Hz tick on the monotonic clock. */
+static int64_t tick_time(EMU emu, uint64_t tick) {
+  return emu->origin + (int64_t)(tick * NS_PER_SEC / TIMER_HZ);
+}
+
+/*
+ * Passes the sound events of the chip on to the audio queue. The budget of
+ * a tick is spread evenly over it, so the cycle of an event gives its time
+ * within the tick. With no budget the events land at the end of the tick.
+ */
+static void queue_sound_events(EMU emu, uint64_t start, uint32_t budget) {
+  ChipSoundEvent events[SOUND_EVENTS];
+  size_t count = chip_take_sound_events(emu->chip, events);
+  int64_t tick_start = (int64_t)(emu->ticks * NS_PER_SEC / TIMER_HZ);
+
+  if (emu->sound == NULL)
+    return;
+
+  for (size_t i = 0; i < count; i++) {
+    uint64_t cycles = events[i].cycle - start;
+    int64_t at = cycles < budget ? (int64_t)cycles * TICK_NS / budget : TICK_NS;
+    AudioEvent event = {
+        .time = tick_start + at, .on = events[i].on, .sound = events[i].audio};
+
+    audio_queue_push(emu->sound, &event);
+  }
+}
+
+/*
+ * Runs one 60 Hz tick: the instructions due at the current rate, then the
+ * timers and the vertical blank. Rates that aren't a multiple of 60 carry
+ * the rest over to the next tick. While rewinding, the tick steps back a
+ * frame instead.
+ */
+static void run_tick(EMU emu) {
+  MovieFrame mf = {
+      .input = __atomic_load_n(&emu->input, __ATOMIC_ACQUIRE),
+      .key = __atomic_load_n(&emu->input_key, __ATOMIC_ACQUIRE),
+      .hz = __atomic_load_n(&emu->sys->chip_freq, __ATOMIC_RELAXED)};
+  uint64_t start = chip_get_cycle(emu->chip);
+  uint64_t due;
+  uint32_t budget;
+
+  if (emu->rewind && __atomic_load_n(&emu->rewinding, __ATOMIC_ACQUIRE)) {
+    if (rewind_pop(emu->rewind, emu->chip))
+      queue_sound_events(emu, start, 0);
+    emu->ticks++;
+    return;
+  }
+
+  if (emu->movie && !movie_step(emu->movie, &mf)) {
+    printf("Movie finished, back to the keyboard\n");
+    emu->movie = NULL;
+  }
+
+  due = (uint64_t)emu->cycle_rest + mf.hz;
+  budget = (uint32_t)(due / TIMER_HZ);
+  emu->cycle_rest = due % TIMER_HZ;
+
+  chip_update_input(emu->chip, mf.input, mf.key);
+  chip_run_cycles(emu->chip, budget);
+  queue_sound_events(emu, start, budget);
+  chip_update_timers(emu->chip);
+  queue_sound_events(emu, start, 0);
+  if (emu->rewind)
+    rewind_push(emu->rewind, emu->chip);
+  emu->ticks++;
+}
+
+/* Saves or loads the state if asked to, the chip is between ticks. */
+static void handle_state_request(EMU emu) {
+  uint8_t request =
+      __atomic_exchange_n(&emu->state_request, STATE_NONE, __ATOMIC_ACQ_REL);
+  const char *error;
+
+  if (request == STATE_NONE || emu->state_path == NULL)
+    return;
+
+  if (request == STATE_LOAD && emu->movie) {
+    printf("WARNING: states can't be loaded while a movie is running\n");
+    return;
+  }
+
+  if (request == STATE_SAVE)
+    error = state_save(emu->chip, emu->state_path);
+  else
+    error = state_load(emu->chip, emu->state_path);
+
+  if (error == NULL && request == STATE_LOAD && emu->rewind)
+    rewind_clear(emu->rewind);
+
+  if (error != NULL)
+    printf("WARNING: %s\n", error);
+  else
+    printf("State %s %s\n", request == STATE_SAVE ? "saved to" : "loaded from",
+           emu->state_path);
+}
+
+/* Dumps the profile if asked to, the counters are still between ticks. */
+static void handle_profile_request(EMU emu) {
+  if (!__atomic_exchange_n(&emu->profile_request, false, __ATOMIC_ACQ_REL))
+    return;
+
+  if (emu->profiling && emu->profile_path != NULL)
+    profile_dump(chip_get_profile(emu->chip), emu->profile_path);
+}
+
+/*
+ * Ticks are scheduled against a fixed origin, so the rate doesn't drift.
+ * Ticks missed while the thread was late are run back to back, up to
+ * MAX_CATCH_UP of them; a longer stall is skipped rather than replayed.
+ */
+static void *emu_main(void *arg) {
+  EMU emu = arg;
+
+  emu->origin = now_ns();
+
+  while (!__atomic_load_n(&emu->stop, __ATOMIC_ACQUIRE)) {
+    sleep_until(tick_time(emu, emu->ticks + 1));
+
+    uint64_t due = (uint64_t)(now_ns() - emu->origin) * TIMER_HZ / NS_PER_SEC;
+    if (due > emu->ticks + MAX_CATCH_UP)
+      emu->ticks = due - MAX_CATCH_UP;
+
+    handle_state_request(emu);
+    handle_profile_request(emu);
+
+    while (emu->ticks < due && chip_get_status(emu->chip) == CHIP_RUNNING)
+      run_tick(emu);
+    if (chip_get_status(emu->chip) != CHIP_RUNNING)
+      break;
+
+    publish(emu);
+  }
+
+  __atomic_store_n(&emu->running, false, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+static void pin_thread(pthread_t thread, uint16_t cpu) {
+  cpu_set_t set;
+
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if (pthread_setaffinity_np(thread, sizeof(set), &set) != 0)
+    printf("WARNING: failed to pin the emulation thread to cpu %u\n", cpu);
+}
+
+EMU emu_start(CHIP8 chip, EmuConfig config) {
+  EMU emu = calloc(1, sizeof(struct emu));
+
+  if (emu == NULL)
+    terminate("Failed to allocate memory");
+
+  emu->chip = chip;
+  emu->sys = config.sys;
+  emu->sound = config.sound;
+  emu->state_path = config.state_path;
+  emu->profile_path = config.profile_path;
+  emu->rewind = config.rewind;
+  emu->movie = config.movie;
+  emu->keys = config.keys ? config.keys : input_keys;
+  emu->back = 0;
+  emu->middle = 1;
+  emu->front = 2;
+  emu->running = true;
+  /* Settling the counters writes them, so only ask before the thread runs. */
+  emu->profiling = chip_get_profile(chip) != NULL;
+
+  /* The renderer may ask for a frame before the first one is published. */
+  chip_get_frame(chip, &emu->frames[emu->front]);
+  emu->frames[emu->front].dirty_rows = 0;
+
+  if (pthread_create(&emu->thread, NULL, &emu_main, emu) != 0)
+    terminate("Failed to start the emulation thread");
+  if (config.pin)
+    pin_thread(emu->thread, config.cpu);
+
+  return emu;
+}
+
+/* Stops and joins the thread. The chip can be used again afterwards. */
+void emu_stop(EMU emu) {
+  __atomic_store_n(&emu->stop, true, __ATOMIC_RELEASE);
+  pthread_join(emu->thread, NULL);
+  free(emu);
+}
+
+bool emu_is_running(EMU emu) {
+  return __atomic_load_n(&emu->running, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * Returns the newest published frame. It stays valid until the next call.
+ * If frames were skipped since the last call, every row is marked dirty.
+ */
+const ChipFrame *emu_acquire_frame(EMU emu) {
+  ChipFrame *frame;
+
+  if (__atomic_load_n(&emu->middle, __ATOMIC_ACQUIRE) & FRESH) {
+    emu->front =
+        __atomic_exchange_n(&emu->middle, emu->front, __ATOMIC_ACQ_REL) & 3;
+    frame = &emu->frames[emu->front];
+
+    if (emu->seqs[emu->front] != emu->front_seq + 1)
+      frame->dirty_rows = ~0ull >> (64 - frame->screen_height);
+    emu->front_seq = emu->seqs[emu->front];
+  } else {
+    frame = &emu->frames[emu->front];
+    frame->dirty_rows = 0;
+  }
+
+  return frame;
+}
+
+void emu_key_pressed(EMU emu, uint8_t key) {
+  __atomic_store_n(&emu->input_key, key, __ATOMIC_RELEASE);
+  __atomic_fetch_or(&emu->input, 1 << key, __ATOMIC_ACQ_REL);
+}
+
+void emu_key_released(EMU emu, uint8_t key) {
+  __atomic_fetch_and(&emu->input, ~(1 << key), __ATOMIC_ACQ_REL);
+}
+
+void emu_save_state(EMU emu) {
+  __atomic_store_n(&emu->state_request, STATE_SAVE, __ATOMIC_RELEASE);
+}
+
+void emu_load_state(EMU emu) {
+  __atomic_store_n(&emu->state_request, STATE_LOAD, __ATOMIC_RELEASE);
+}
+
+/* Rewinds one frame per tick for as long as it is set. */
+void emu_set_rewinding(EMU emu, bool rewinding) {
+  __atomic_store_n(&emu->rewinding, rewinding, __ATOMIC_RELEASE);
+}
+
+void emu_dump_profile(EMU emu) {
+  __atomic_store_n(&emu->profile_request, true, __ATOMIC_RELEASE);
+}
+
+static void emu_handler(InputHandler *h) {
+  EMU emu = h->ctx;
+
+  switch (h->event) {
+  case DOWN:
+    emu_key_pressed(emu, h->alt);
+    break;
+  case RELEASED:
+    emu_key_released(emu, h->alt);
+    break;
+  default:
+    break;
+  }
+}
+
+static void emu_rewind_handler(InputHandler *h) {
+  emu_set_rewinding(h->ctx, h->event == DOWN);
+}
+
+static void emu_profile_handler(InputHandler *h) { emu_dump_profile(h->ctx); }
+
+static void emu_state_handler(InputHandler *h) {
+  if (h->alt == STATE_SAVE)
+    emu_save_state(h->ctx);
+  else
+    emu_load_state(h->ctx);
+}
+
+void emu_register_input_handlers(EMU emu, MEDIA media) {
+  InputHandler sh = {.keycode = SAVE_STATE_KEY,
+                     .alt = STATE_SAVE,
+                     .event = PRESSED,
+                     .ctx = emu,
+                     .handle = &emu_state_handler};
+  InputHandler lh = {.keycode = LOAD_STATE_KEY,
+                     .alt = STATE_LOAD,
+                     .event = PRESSED,
+                     .ctx = emu,
+                     .handle = &emu_state_handler};
+
+  InputHandler rdh = {.keycode = REWIND_KEY,
+                      .event = DOWN,
+                      .ctx = emu,
+                      .handle = &emu_rewind_handler};
+  InputHandler ruh = {.keycode = REWIND_KEY,
+                      .event = RELEASED,
+                      .ctx = emu,
+                      .handle = &emu_rewind_handler};
+  InputHandler ph = {.keycode = PROFILE_KEY,
+                     .event = PRESSED,
+                     .ctx = emu,
+                     .handle = &emu_profile_handler};
+
+  media_register_input_handler(media, sh);
+  media_register_input_handler(media, lh);
+  if (emu->rewind) {
+    media_register_input_handler(media, rdh);
+    media_register_input_handler(media, ruh);
+  }
+  if (emu->profiling)
+    media_register_input_handler(media, ph);
+
+  for (uint8_t i = 0; i < 16; i++) {
+    InputHandler dh = {.keycode = emu->keys[i],
+                       .alt = i,
+                       .event = DOWN,
+                       .ctx = emu,
+                       .handle = &emu_handler};
+    media_register_input_handler(media, dh);
+    InputHandler uh = {.keycode = emu->keys[i],
+                       .alt = i,
+                       .event = RELEASED,
+                       .ctx = emu,
+                       .handle = &emu_handler};
+    media_register_input_handler(media, uh);
+  }
+}
@@ -0,0 +1,49 @@
+#ifndef EMU_H
+#define EMU_H
+
+#include "audio.h"
+#include "chip.h"
+#include "media.h"
+#include "movie.h"
+#include "rewind.h"
+#include "sys.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Runs a chip on its own thread at 60 frames per second. Finished frames
+ * are handed to the render thread through a triple buffer, so neither side
+ * ever waits for the other. Sound events go to the audio queue, if one is
+ * given. Save states are written to and read from state_path between ticks.
+ * With a rewind history, every frame is pushed to it and holding the rewind
+ * key steps back through them. A movie records the input of every tick, or
+ * replays it in place of the keyboard until it runs out. Profile builds
+ * dump their counters to profile_path on request.
+ */
+typedef struct emu *EMU;
+typedef struct EmuConfig {
+  SYS *sys;
+  AUDIO_QUEUE sound;
+  const char *state_path;
+  const char *profile_path;
+  REWIND rewind;
+  MOVIE movie;
+  bool pin;
+  uint16_t cpu;
+  /* The keyboard key of every Chip-8 key, input_keys when NULL. */
+  const uint8_t *keys;
+} EmuConfig;
+
+EMU emu_start(CHIP8, EmuConfig);
+void emu_stop(EMU);
+bool emu_is_running(EMU);
+const ChipFrame *emu_acquire_frame(EMU);
+void emu_key_pressed(EMU, uint8_t);
+void emu_key_released(EMU, uint8_t);
+void emu_save_state(EMU);
+void emu_load_state(EMU);
+void emu_set_rewinding(EMU, bool);
+void emu_dump_profile(EMU);
+void emu_register_input_handlers(EMU, MEDIA);
+
+#endif
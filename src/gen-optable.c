@@ -0,0 +1,22 @@
+#include "opcodes.h"
+#include <stdio.h>
+
+/*
+ * Writes optable.h: a 64K table mapping every opcode to its ChipOp, used
+ * by the threaded dispatch loop to jump straight to a handler label.
+ */
+int main(void) {
+  printf("/* Generated by gen-optable. Do not edit. */\n");
+  printf("#ifndef OPTABLE_H\n#define OPTABLE_H\n\n");
+  printf("static const uint8_t optable[0x10000] = {\n");
+
+  for (unsigned long opcode = 0; opcode <= 0xFFFF; opcode++) {
+    printf("%d,", opcode_classify((uint16_t)opcode));
+    if ((opcode & 0x1F) == 0x1F)
+      printf("\n");
+  }
+
+  printf("};\n\n#endif\n");
+
+  return 0;
+}
@@ -0,0 +1,369 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "args.h"
+#include "chip.h"
+#include "config.h"
+#include "lockstep.h"
+#include "media.h"
+#include "movie.h"
+#include "profile.h"
+#include "romdb.h"
+#include "sys.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_FRAMES 600
+#define DEFAULT_CPF 1000
+#define TIMER_HZ 60
+
+Config *parse_args_into_config(int argc, char **argv) {
+  Config *config = config_init();
+
+  ArgParserOptions *options = args_init_options(12);
+  args_add_options(
+      options, 12,
+      (ArgParserOption){.lng = "frames",
+                        .shrt = 'n',
+                        .description = "number of 60 Hz frames to run",
+                        .parse = &parse_uint_arg_value,
+                        .set = &config_set_frames},
+      (ArgParserOption){.lng = "cycles",
+                        .shrt = 'c',
+                        .description = "number of chip cycles to run. When "
+                                       "combined with --frames, whichever "
+                                       "runs out first stops the run",
+                        .parse = &parse_uint_arg_value,
+                        .set = &config_set_cycles},
+      (ArgParserOption){.lng = "cpf",
+                        .shrt = 'p',
+                        .description = "chip cycles per frame. Default: 1000",
+                        .parse = &parse_uint_arg_value,
+                        .set = &config_set_cpf},
+      (ArgParserOption){.lng = "lanes",
+                        .shrt = 'l',
+                        .description = "run that many instances of the rom "
+                                       "on the lockstep engine, up to 64",
+                        .parse = &parse_uint_arg_value,
+                        .set = &config_set_lanes},
+      (ArgParserOption){.lng = "input",
+                        .shrt = 'i',
+                        .description =
+                            "input script with \"<frame> <key> <down|up>\" "
+                            "lines, key being a Chip-8 key in hex",
+                        .parse = &parse_string_arg_value,
+                        .set = &config_set_input_script},
+      (ArgParserOption){.lng = "record",
+                        .shrt = 'm',
+                        .description = "record the input to a movie file",
+                        .parse = &parse_string_arg_value,
+                        .set = &config_set_record},
+      (ArgParserOption){.lng = "replay",
+                        .shrt = 'e',
+                        .description =
+                            "replay a movie file with the core, quirks, seed "
+                            "and speed it was recorded with. Runs to its end "
+                            "unless --frames or --cycles is given",
+                        .parse = &parse_string_arg_value,
+                        .set = &config_set_replay},
+      (ArgParserOption){.lng = "core",
+                        .shrt = 'k',
+                        .description = "core to run the rom on: chip-8, "
+                                       "super-chip or xo-chip. Default: "
+                                       "picked from the rom",
+                        .parse = &parse_core_arg_value,
+                        .set = &config_set_core},
+      (ArgParserOption){.lng = "quirk",
+                        .shrt = 'q',
+                        .description = "enable a quirk, same values as for "
+                                       "chipo8o. Can be used multiple times",
+                        .parse = &parse_chip_quirk_arg_value,
+                        .set = &config_set_chip_quirks},
+      (ArgParserOption){.lng = "seed",
+                        .shrt = 's',
+                        .description = "seed for the random number generator. "
+                                       "Default: 0",
+                        .parse = &parse_uint_arg_value,
+                        .set = &config_set_seed},
+      (ArgParserOption){.lng = "db",
+                        .shrt = 'x',
+                        .description = "rom database to take the core, "
+                                       "quirks and cpf of the rom from",
+                        .parse = &parse_string_arg_value,
+                        .set = &config_set_db},
+      (ArgParserOption){.lng = "help",
+                        .shrt = 'h',
+                        .description = "display this help and exit",
+                        .parse = &display_help_message,
+                        .set = NULL});
+
+  args_parse(options, argc, argv, config);
+  args_destroy(options);
+
+  return config;
+}
+
+static double elapsed_seconds(struct timespec *start, struct timespec *end) {
+  return (double)(end->tv_sec - start->tv_sec) +
+         (double)(end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+typedef struct {
+  LOCKSTEP ls;
+  uint16_t input;
+  uint8_t key;
+} LockstepInput;
+
+/* Applies a scripted key event to every lane, like chip_handler does. */
+static void lockstep_input_handler(InputHandler *h) {
+  LockstepInput *li = h->ctx;
+
+  switch (h->event) {
+  case DOWN:
+    li->input |= 1 << h->alt;
+    li->key = h->alt;
+    break;
+  case RELEASED:
+    li->input &= ~(1 << h->alt);
+    break;
+  default:
+    return;
+  }
+
+  for (uint8_t lane = 0; lane < lockstep_get_lanes(li->ls); lane++)
+    lockstep_update_input(li->ls, lane, li->input, li->key);
+}
+
+static void run_lockstep(Config *config, RomData *rd, uint16_t cpf) {
+  LockstepConfig lconfig = {.quirks = config->chip_quirks,
+                            .seed = config->seed,
+                            .lanes = config->lanes};
+  LockstepInput li;
+  LOCKSTEP ls;
+  uint64_t cycles = 0, steps = 0;
+  uint32_t frames = 0;
+  struct timespec start, end;
+  bool running = true;
+
+  if (config->core != &chip8_core)
+    terminate("--lanes is only available for the chip-8 core");
+
+  ls = lockstep_init(lconfig);
+  if (ls == NULL)
+    terminate("Failed to initialize lanes, 1 to 64 are supported");
+  lockstep_load_rom(ls, rd->data, rd->size);
+  li = (LockstepInput){.ls = ls, .input = 0, .key = 0};
+
+  MEDIA media = media_init((MediaConfig){.input_script = config->input_script});
+  for (uint8_t i = 0; i < 16; i++) {
+    InputHandler dh = {.keycode = input_keys[i],
+                       .alt = i,
+                       .event = DOWN,
+                       .ctx = &li,
+                       .handle = &lockstep_input_handler};
+    media_register_input_handler(media, dh);
+    InputHandler uh = {.keycode = input_keys[i],
+                       .alt = i,
+                       .event = RELEASED,
+                       .ctx = &li,
+                       .handle = &lockstep_input_handler};
+    media_register_input_handler(media, uh);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  while ((config->frames == 0 || frames < config->frames) &&
+         (config->cycles == 0 || cycles < config->cycles) && running) {
+    uint32_t budget = cpf;
+
+    if (config->cycles && config->cycles - cycles < budget)
+      budget = (uint32_t)(config->cycles - cycles);
+
+    steps += lockstep_run_cycles(ls, budget);
+    cycles += budget;
+    media_read_input(media);
+    lockstep_update_timers(ls);
+    frames++;
+
+    running = false;
+    for (uint8_t lane = 0; lane < config->lanes; lane++)
+      running |= lockstep_get_status(ls, lane) == CHIP_RUNNING;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  double seconds = elapsed_seconds(&start, &end);
+
+  printf("lanes: %u\n", config->lanes);
+  printf("frames: %u\n", frames);
+  printf("cycles: %llu\n", (unsigned long long)cycles);
+  printf("elapsed: %.6f s\n", seconds);
+  printf("lane cycles/sec: %.0f\n", seconds > 0 ? steps / seconds : 0.0);
+  for (uint8_t lane = 0; lane < config->lanes; lane++) {
+    ChipStatus status = lockstep_get_status(ls, lane);
+
+    uint64_t hash = hash_bytes(lockstep_get_vram_rows(ls, lane),
+                               VRAM_SIZE * sizeof(uint64_t));
+
+    printf("lane %u: %s, vram hash %016llx\n", lane,
+           status == CHIP_RUNNING ? "budget" : chip_status_name(status),
+           (unsigned long long)hash);
+  }
+
+  media_destroy(media);
+  lockstep_destroy(ls);
+}
+
+/*
+ * Opens the movie asked for, if any. A replay brings its own core, quirks
+ * and seed, a recording is paced at cpf and can be fed by an input script.
+ */
+static MOVIE open_movie(Config *config, RomData *rd, uint16_t cpf) {
+  MovieInfo info = {.seed = config->seed,
+                    .hz = (uint32_t)cpf * TIMER_HZ,
+                    .quirks = config->chip_quirks,
+                    .core = config->core};
+  const char *error = NULL;
+  MOVIE movie = NULL;
+
+  if (config->record && config->replay)
+    terminate("--record and --replay can't be combined");
+  if (config->replay && config->input_script)
+    terminate("--input can't be combined with --replay");
+
+  if (config->replay)
+    error = movie_replay(config->replay, rd, &info, &movie);
+  else if (config->record)
+    error = movie_record(config->record, rd, info, &movie);
+  if (error != NULL)
+    terminate(error);
+
+  config->chip_quirks = info.quirks;
+  config->seed = info.seed;
+  config->core = info.core;
+  return movie;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2)
+    terminate("Usage: chipo8o-headless [FILE] [OPTION]...");
+
+  Config *config = parse_args_into_config(argc, argv);
+  RomData rd = read_rom_file(argv[1]);
+
+  if (config->db != NULL) {
+    bool found;
+    const char *error = romdb_configure(
+        config->db, hash_bytes(rd.data, rd.size), config, &found);
+
+    if (error != NULL)
+      terminate(error);
+  }
+
+  uint16_t cpf = config->cpf ? config->cpf : DEFAULT_CPF;
+
+  if (config->core == NULL)
+    config->core = chip_detect_core(rd.data, rd.size);
+  MOVIE movie = open_movie(config, &rd, cpf);
+  if (!chip_rom_fits(config->core, rd.size))
+    terminate("Rom does not fit into the memory of the core");
+
+  if (config->frames == 0 && config->cycles == 0 && config->replay == NULL)
+    config->frames = DEFAULT_FRAMES;
+
+  if (config->lanes) {
+    if (movie != NULL)
+      terminate("--lanes can't be combined with a movie");
+    run_lockstep(config, &rd, cpf);
+    free(rd.data);
+    free(config);
+    return 0;
+  }
+
+  SYS *sys = sys_init();
+
+  CHIP8 chip = chip_init((ChipConfig){.quirks = config->chip_quirks,
+                                      .seed = config->seed,
+                                      .core = config->core});
+  if (chip == NULL)
+    terminate("Failed to allocate memory");
+  chip_load_rom(chip, rd.data, rd.size);
+  free(rd.data);
+
+  MediaConfig mconfig = {.input_script = config->input_script};
+  MEDIA media = media_init(mconfig);
+
+  register_input_handlers(media, sys, chip);
+
+  uint64_t cycles = 0;
+  uint32_t frames = 0, cycle_rest = 0;
+  struct timespec start, end;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  while ((config->frames == 0 || frames < config->frames) &&
+         (config->cycles == 0 || cycles < config->cycles) &&
+         chip_get_status(chip) == CHIP_RUNNING) {
+    uint32_t budget = cpf;
+
+    /* Movies are paced like the emulation thread, by rate and not cpf. */
+    if (movie != NULL) {
+      MovieFrame mf = {.input = chip_get_input(chip),
+                       .key = chip_get_input_key(chip),
+                       .hz = cpf * TIMER_HZ};
+
+      if (!movie_step(movie, &mf))
+        break;
+      chip_update_input(chip, mf.input, mf.key);
+      budget = (cycle_rest + mf.hz) / TIMER_HZ;
+      cycle_rest = (cycle_rest + mf.hz) % TIMER_HZ;
+    }
+
+    if (config->cycles && config->cycles - cycles < budget)
+      budget = (uint32_t)(config->cycles - cycles);
+
+    cycles += chip_run_cycles(chip, budget);
+    media_read_input(media);
+    chip_update_timers(chip);
+    frames++;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  double seconds = elapsed_seconds(&start, &end);
+  size_t vram_size = (size_t)chip_get_screen_width(chip) *
+                     chip_get_screen_height(chip) * chip_get_planes(chip) / 8;
+
+  printf("exit: %s\n", chip_get_status(chip) == CHIP_RUNNING
+                            ? "budget"
+                            : chip_status_name(chip_get_status(chip)));
+  printf("frames: %u\n", frames);
+  printf("cycles: %llu\n", (unsigned long long)cycles);
+  printf("elapsed: %.6f s\n", seconds);
+  printf("cycles/sec: %.0f\n", seconds > 0 ? cycles / seconds : 0.0);
+  printf("vram hash: %016llx\n",
+         (unsigned long long)hash_bytes(chip_get_vram_rows(chip), vram_size));
+
+  if (chip_get_profile(chip) != NULL) {
+    char profile_path[FILENAME_MAX];
+
+    profile_csv_path(profile_path, sizeof(profile_path), argv[1]);
+    profile_dump(chip_get_profile(chip), profile_path);
+  }
+
+  if (movie != NULL) {
+    const char *error = movie_close(movie);
+
+    if (error != NULL)
+      printf("WARNING: %s\n", error);
+  }
+
+  chip_destroy(chip);
+  media_destroy(media);
+  sys_destroy(sys);
+  free(config);
+
+  return 0;
+}
@@ -0,0 +1,153 @@
+#define _DEFAULT_SOURCE
+
+#include "jit-x64.h"
+#include <string.h>
+#include <sys/mman.h>
+
+/* ModRM byte for [rbx + disp32] with the given register field. */
+#define MODRM_RBX_DISP32(reg) (0x80 | (reg) << 3 | 0x3)
+
+JitBuffer *jit_buffer_init(size_t size) {
+  JitBuffer *buf = malloc(sizeof(JitBuffer));
+
+  if (buf == NULL)
+    return NULL;
+
+  buf->base = mmap(NULL, size, PROT_READ | PROT_WRITE | PROT_EXEC,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (buf->base == MAP_FAILED) {
+    free(buf);
+    return NULL;
+  }
+
+  buf->size = size;
+  buf->used = 0;
+
+  return buf;
+}
+
+void jit_buffer_destroy(JitBuffer *buf) {
+  munmap(buf->base, buf->size);
+  free(buf);
+}
+
+void jit_buffer_reset(JitBuffer *buf) { buf->used = 0; }
+
+void jit_begin(JitBuffer *buf, JitEmitter *e) {
+  e->start = buf->base + buf->used;
+  e->cur = e->start;
+  e->end = buf->base + buf->size;
+  e->overflow = false;
+}
+
+/* Returns the entry point of the emitted code or NULL if it did not fit. */
+void *jit_commit(JitBuffer *buf, JitEmitter *e) {
+  if (e->overflow)
+    return NULL;
+
+  buf->used = (size_t)(e->cur - buf->base);
+  buf->used = (buf->used + 15) & ~(size_t)15;
+  if (buf->used > buf->size)
+    buf->used = buf->size;
+
+  return e->start;
+}
+
+static void emit(JitEmitter *e, const uint8_t *bytes, size_t size) {
+  if (e->overflow || (size_t)(e->end - e->cur) < size) {
+    e->overflow = true;
+    return;
+  }
+
+  memcpy(e->cur, bytes, size);
+  e->cur += size;
+}
+
+static void emit_rbx_disp(JitEmitter *e, const uint8_t *op, size_t op_size,
+                          uint8_t reg, int32_t disp) {
+  uint8_t bytes[8];
+
+  memcpy(bytes, op, op_size);
+  bytes[op_size] = MODRM_RBX_DISP32(reg);
+  memcpy(&bytes[op_size + 1], &disp, sizeof(disp));
+  emit(e, bytes, op_size + 5);
+}
+
+void jit_emit_prologue(JitEmitter *e) {
+  /* push rbx; mov rbx, rdi */
+  const uint8_t code[] = {0x53, 0x48, 0x89, 0xFB};
+  emit(e, code, sizeof(code));
+}
+
+void jit_emit_epilogue(JitEmitter *e, uint32_t ret) {
+  /* mov eax, imm32; pop rbx; ret */
+  uint8_t code[] = {0xB8, 0, 0, 0, 0, 0x5B, 0xC3};
+  memcpy(&code[1], &ret, sizeof(ret));
+  emit(e, code, sizeof(code));
+}
+
+void jit_emit_store8(JitEmitter *e, int32_t disp, uint8_t value) {
+  const uint8_t op[] = {0xC6};
+  emit_rbx_disp(e, op, sizeof(op), 0, disp);
+  emit(e, &value, 1);
+}
+
+void jit_emit_store16(JitEmitter *e, int32_t disp, uint16_t value) {
+  const uint8_t op[] = {0x66, 0xC7};
+  emit_rbx_disp(e, op, sizeof(op), 0, disp);
+  emit(e, (const uint8_t *)&value, 2);
+}
+
+void jit_emit_add8(JitEmitter *e, int32_t disp, uint8_t value) {
+  const uint8_t op[] = {0x80};
+  emit_rbx_disp(e, op, sizeof(op), 0, disp);
+  emit(e, &value, 1);
+}
+
+void jit_emit_load_al(JitEmitter *e, int32_t disp) {
+  /* movzx eax, byte [rbx + disp] */
+  const uint8_t op[] = {0x0F, 0xB6};
+  emit_rbx_disp(e, op, sizeof(op), 0, disp);
+}
+
+void jit_emit_store_al(JitEmitter *e, int32_t disp) {
+  const uint8_t op[] = {0x88};
+  emit_rbx_disp(e, op, sizeof(op), 0, disp);
+}
+
+void jit_emit_add_al(JitEmitter *e, int32_t disp) {
+  const uint8_t op[] = {0x02};
+  emit_rbx_disp(e, op, sizeof(op), 0, disp);
+}
+
+void jit_emit_sub_al(JitEmitter *e, int32_t disp) {
+  const uint8_t op[] = {0x2A};
+  emit_rbx_disp(e, op, sizeof(op), 0, disp);
+}
+
+void jit_emit_logic_al(JitEmitter *e, JitLogicOp logic, int32_t disp) {
+  const uint8_t op[] = {(uint8_t)logic};
+  emit_rbx_disp(e, op, sizeof(op), 0, disp);
+}
+
+/* Stores the carry condition of the last arithmetic op as 0/1 via cl. */
+void jit_emit_setcc_store(JitEmitter *e, JitCond cond, int32_t disp) {
+  const uint8_t setcc[] = {0x0F, (uint8_t)cond, 0xC1};
+  const uint8_t op[] = {0x88};
+  emit(e, setcc, sizeof(setcc));
+  emit_rbx_disp(e, op, sizeof(op), 1, disp);
+}
+
+/* Calls fn(context, arg). rbx is callee-saved so it survives the call. */
+void jit_emit_call(JitEmitter *e, void (*fn)(void), const void *arg) {
+  uint8_t code[] = {0x48, 0x89, 0xDF,                   /* mov rdi, rbx */
+                    0x48, 0xBE, 0,    0, 0, 0, 0, 0, 0, 0, /* mov rsi, arg */
+                    0x48, 0xB8, 0,    0, 0, 0, 0, 0, 0, 0, /* mov rax, fn */
+                    0xFF, 0xD0};                       /* call rax */
+  uint64_t a = (uint64_t)(uintptr_t)arg;
+  uint64_t f = (uint64_t)(uintptr_t)fn;
+
+  memcpy(&code[5], &a, sizeof(a));
+  memcpy(&code[15], &f, sizeof(f));
+  emit(e, code, sizeof(code));
+}
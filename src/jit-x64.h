@@ -0,0 +1,49 @@
+#ifndef JIT_X64_H
+#define JIT_X64_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * Minimal x86-64 code emitter for the block JIT. Generated functions take
+ * the machine context in rdi, keep it in rbx for the whole block and
+ * address all state as [rbx + disp32].
+ */
+typedef struct JitBuffer {
+  uint8_t *base;
+  size_t size;
+  size_t used;
+} JitBuffer;
+
+typedef struct JitEmitter {
+  uint8_t *start;
+  uint8_t *cur;
+  uint8_t *end;
+  bool overflow;
+} JitEmitter;
+
+typedef enum { JIT_OR = 0x08, JIT_AND = 0x20, JIT_XOR = 0x30 } JitLogicOp;
+typedef enum { JIT_CARRY = 0x92, JIT_NO_CARRY = 0x93 } JitCond;
+
+JitBuffer *jit_buffer_init(size_t);
+void jit_buffer_destroy(JitBuffer *);
+void jit_buffer_reset(JitBuffer *);
+
+void jit_begin(JitBuffer *, JitEmitter *);
+void *jit_commit(JitBuffer *, JitEmitter *);
+
+void jit_emit_prologue(JitEmitter *);
+void jit_emit_epilogue(JitEmitter *, uint32_t);
+void jit_emit_store8(JitEmitter *, int32_t, uint8_t);
+void jit_emit_store16(JitEmitter *, int32_t, uint16_t);
+void jit_emit_add8(JitEmitter *, int32_t, uint8_t);
+void jit_emit_load_al(JitEmitter *, int32_t);
+void jit_emit_store_al(JitEmitter *, int32_t);
+void jit_emit_add_al(JitEmitter *, int32_t);
+void jit_emit_sub_al(JitEmitter *, int32_t);
+void jit_emit_logic_al(JitEmitter *, JitLogicOp, int32_t);
+void jit_emit_setcc_store(JitEmitter *, JitCond, int32_t);
+void jit_emit_call(JitEmitter *, void (*)(void), const void *);
+
+#endif
@@ -0,0 +1,690 @@
+#include "lockstep.h"
+#include "opcodes.h"
+#include "rng.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+typedef __m256i Vec;
+
+#define VEC_SIZE 32
+#define vec_load(p) _mm256_loadu_si256((const Vec *)(p))
+#define vec_store(p, v) _mm256_storeu_si256((Vec *)(p), (v))
+#define vec_set8(v) _mm256_set1_epi8((char)(v))
+#define vec_set16(v) _mm256_set1_epi16((short)(v))
+#define vec_zero() _mm256_setzero_si256()
+#define vec_and _mm256_and_si256
+#define vec_or _mm256_or_si256
+#define vec_xor _mm256_xor_si256
+#define vec_andnot _mm256_andnot_si256
+#define vec_add8 _mm256_add_epi8
+#define vec_sub8 _mm256_sub_epi8
+#define vec_adds8 _mm256_adds_epu8
+#define vec_subs8 _mm256_subs_epu8
+#define vec_eq8 _mm256_cmpeq_epi8
+#define vec_add16 _mm256_add_epi16
+#define vec_mul16 _mm256_mullo_epi16
+#define vec_eq16 _mm256_cmpeq_epi16
+#define vec_min16 _mm256_min_epu16
+#define vec_srl16 _mm256_srli_epi16
+#define vec_blend _mm256_blendv_epi8
+#define vec_movemask _mm256_movemask_epi8
+#define vec_pack16(a, b)                                                       \
+  _mm256_permute4x64_epi64(_mm256_packs_epi16(a, b), 0xD8)
+#define vec_widen8(p)                                                          \
+  _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(p)))
+#define vec_zext8(p)                                                           \
+  _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(p)))
+#define vec_fold16(v)                                                          \
+  _mm_min_epu16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1))
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+
+typedef __m128i Vec;
+
+#define VEC_SIZE 16
+#define vec_load(p) _mm_loadu_si128((const Vec *)(p))
+#define vec_store(p, v) _mm_storeu_si128((Vec *)(p), (v))
+#define vec_set8(v) _mm_set1_epi8((char)(v))
+#define vec_set16(v) _mm_set1_epi16((short)(v))
+#define vec_zero() _mm_setzero_si128()
+#define vec_and _mm_and_si128
+#define vec_or _mm_or_si128
+#define vec_xor _mm_xor_si128
+#define vec_andnot _mm_andnot_si128
+#define vec_add8 _mm_add_epi8
+#define vec_sub8 _mm_sub_epi8
+#define vec_adds8 _mm_adds_epu8
+#define vec_subs8 _mm_subs_epu8
+#define vec_eq8 _mm_cmpeq_epi8
+#define vec_add16 _mm_add_epi16
+#define vec_mul16 _mm_mullo_epi16
+#define vec_eq16 _mm_cmpeq_epi16
+#define vec_min16 _mm_min_epu16
+#define vec_srl16 _mm_srli_epi16
+#define vec_blend _mm_blendv_epi8
+#define vec_movemask _mm_movemask_epi8
+#define vec_pack16(a, b) _mm_packs_epi16(a, b)
+#define vec_widen8(p) _mm_cvtepi8_epi16(_mm_loadl_epi64((const __m128i *)(p)))
+#define vec_zext8(p) _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *)(p)))
+#define vec_fold16(v) (v)
+#else
+#error "the lockstep engine needs SSE4.1 or AVX2"
+#endif
+
+#define LANES LOCKSTEP_MAX_LANES
+#define VEC16 (VEC_SIZE / 2)
+#define STACK_SIZE 12
+
+/* Writes v to the lanes of dst selected by the group mask g. */
+#define VEC_PUT(dst, g, v) vec_store(dst, vec_blend(vec_load(dst), v, g))
+
+#define FOR_BYTES(i) for (size_t i = 0; i < LANES; i += VEC_SIZE)
+#define FOR_WORDS(i) for (size_t i = 0; i < LANES; i += VEC16)
+#define FOR_LANES(lane, bits)                                                  \
+  for (uint64_t rest = (bits); rest && ((lane) = __builtin_ctzll(rest), 1);   \
+       rest &= rest - 1)
+
+typedef struct {
+  uint16_t opcode;
+  uint16_t nnn;
+  uint8_t x;
+  uint8_t y;
+  uint8_t kk;
+  uint8_t n;
+  ChipOp op;
+} LaneInstr;
+
+/*
+ * Per-lane state is kept as arrays indexed by lane so a vector register
+ * covers VEC_SIZE lanes of one Chip-8 register. Memory is per lane too;
+ * image holds the code all lanes share and dirty marks addresses where
+ * some lane wrote something else, which forces lane-by-lane decoding.
+ */
+struct lockstep {
+  uint8_t regs[REGS_COUNT][LANES];
+  uint8_t dt[LANES];
+  uint8_t st[LANES];
+  uint16_t pc[LANES];
+  uint16_t index[LANES];
+  uint16_t budget[LANES];
+  uint16_t input[LANES];
+  uint8_t input_key[LANES];
+  uint8_t sp[LANES];
+  uint16_t stack[LANES][STACK_SIZE];
+  ChipStatus status[LANES];
+  uint8_t vblank[LANES];
+  ChipRng rng[LANES];
+  uint64_t vram[LANES][SCREEN_HEIGHT];
+
+  uint8_t group8[LANES];
+  uint16_t group16[LANES];
+  uint8_t cond8[LANES];
+
+  uint8_t (*mem)[MEM_SIZE];
+  uint8_t image[MEM_SIZE];
+  uint8_t dirty[MEM_SIZE];
+  uint8_t lanes;
+  uint8_t quirks;
+};
+
+LOCKSTEP lockstep_init(LockstepConfig conf) {
+  LOCKSTEP ls;
+
+  if (conf.lanes == 0 || conf.lanes > LANES)
+    return NULL;
+
+  ls = calloc(1, sizeof(struct lockstep));
+  if (ls == NULL)
+    return NULL;
+
+  ls->mem = calloc(conf.lanes, MEM_SIZE);
+  if (ls->mem == NULL) {
+    free(ls);
+    return NULL;
+  }
+
+  ls->lanes = conf.lanes;
+  ls->quirks = conf.quirks;
+  memcpy(ls->image, font, sizeof(font));
+
+  for (uint8_t lane = 0; lane < LANES; lane++) {
+    ls->pc[lane] = START_ADDRESS;
+    ls->status[lane] = CHIP_RUNNING;
+    rng_seed(&ls->rng[lane], conf.seed + lane);
+    if (lane < ls->lanes)
+      memcpy(ls->mem[lane], ls->image, MEM_SIZE);
+  }
+
+  return ls;
+}
+
+void lockstep_destroy(LOCKSTEP ls) {
+  free(ls->mem);
+  free(ls);
+}
+
+void lockstep_load_rom(LOCKSTEP ls, const uint8_t *rom, size_t size) {
+  if (size > MEM_SIZE - START_ADDRESS)
+    size = MEM_SIZE - START_ADDRESS;
+
+  memcpy(&ls->image[START_ADDRESS], rom, size);
+  for (uint8_t lane = 0; lane < ls->lanes; lane++)
+    memcpy(&ls->mem[lane][START_ADDRESS], rom, size);
+}
+
+void lockstep_update_timers(LOCKSTEP ls) {
+  Vec one = vec_set8(1);
+
+  FOR_BYTES(i) {
+    vec_store(&ls->dt[i], vec_subs8(vec_load(&ls->dt[i]), one));
+    vec_store(&ls->st[i], vec_subs8(vec_load(&ls->st[i]), one));
+  }
+
+  memset(ls->vblank, 1, sizeof(ls->vblank));
+  for (uint8_t lane = 0; lane < ls->lanes; lane++)
+    if (ls->status[lane] == CHIP_WAITING_VBLANK)
+      ls->status[lane] = CHIP_RUNNING;
+}
+
+void lockstep_update_input(LOCKSTEP ls, uint8_t lane, uint16_t input,
+                           uint8_t key) {
+  ls->input[lane] = input;
+  ls->input_key[lane] = key;
+}
+
+uint8_t lockstep_get_lanes(LOCKSTEP ls) { return ls->lanes; }
+
+ChipStatus lockstep_get_status(LOCKSTEP ls, uint8_t lane) {
+  return ls->status[lane];
+}
+
+uint16_t lockstep_get_pc(LOCKSTEP ls, uint8_t lane) { return ls->pc[lane]; }
+
+bool lockstep_is_sound_timer_active(LOCKSTEP ls, uint8_t lane) {
+  return ls->st[lane] > 0;
+}
+
+/* Rows of the lane's screen, the leftmost pixel in the top bit. */
+const uint64_t *lockstep_get_vram_rows(LOCKSTEP ls, uint8_t lane) {
+  return ls->vram[lane];
+}
+
+static void decode(LaneInstr *in, const uint8_t *mem, uint16_t addr) {
+  in->opcode = mem[addr] << 8 | mem[(addr + 1) & (MEM_SIZE - 1)];
+  in->nnn = in->opcode & 0xFFF;
+  in->x = (uint8_t)(in->opcode >> 8 & 0xF);
+  in->y = (uint8_t)(in->opcode >> 4 & 0xF);
+  in->kk = (uint8_t)(in->opcode & 0xFF);
+  in->n = (uint8_t)(in->opcode & 0xF);
+  in->op = opcode_classify(in->opcode);
+}
+
+static void halt(LOCKSTEP ls, uint8_t lane, ChipStatus status) {
+  ls->status[lane] = status;
+  ls->pc[lane] -= 2;
+  ls->budget[lane] = 0;
+}
+
+static void store(LOCKSTEP ls, uint8_t lane, uint16_t addr, uint8_t value) {
+  addr &= MEM_SIZE - 1;
+  ls->mem[lane][addr] = value;
+  if (value != ls->image[addr])
+    ls->dirty[addr] = 1;
+}
+
+static uint8_t load(LOCKSTEP ls, uint8_t lane, uint16_t addr) {
+  return ls->mem[lane][addr & (MEM_SIZE - 1)];
+}
+
+static void draw(LOCKSTEP ls, uint8_t lane, const LaneInstr *in) {
+  uint8_t x = ls->regs[in->x][lane] & (SCREEN_WIDTH - 1);
+  uint8_t y = ls->regs[in->y][lane] & (SCREEN_HEIGHT - 1);
+  bool clip = ls->quirks & CLIPPING;
+  uint64_t *vram = ls->vram[lane];
+  uint8_t vf = 0;
+
+  for (uint8_t row = 0; row < in->n; row++) {
+    uint64_t line = (uint64_t)load(ls, lane, ls->index[lane] + row) << 56;
+    uint8_t posy = y + row;
+
+    if (posy >= SCREEN_HEIGHT) {
+      if (clip)
+        continue;
+      posy &= SCREEN_HEIGHT - 1;
+    }
+
+    if (x && clip)
+      line >>= x;
+    else if (x)
+      line = line >> x | line << (SCREEN_WIDTH - x);
+
+    if (vram[posy] & line)
+      vf = 1;
+    vram[posy] ^= line;
+  }
+
+  ls->regs[0xF][lane] = vf;
+}
+
+/* Executes an already fetched instruction for a single lane. */
+static void lane_exec(LOCKSTEP ls, uint8_t lane, const LaneInstr *in) {
+  uint8_t *vx = &ls->regs[in->x][lane];
+  uint8_t *vy = &ls->regs[in->y][lane];
+  uint8_t *vf = &ls->regs[0xF][lane];
+  uint8_t flag, src;
+
+  switch (in->op) {
+  case OP_nop:
+    break;
+  case OP_00E0:
+    memset(ls->vram[lane], 0, sizeof(ls->vram[lane]));
+    break;
+  case OP_00EE:
+    if (ls->sp[lane] > 0)
+      ls->pc[lane] = ls->stack[lane][ls->sp[lane]--];
+    break;
+  case OP_1xxx:
+    ls->pc[lane] = in->nnn;
+    break;
+  case OP_2nnn:
+    if (ls->sp[lane] == STACK_SIZE - 1) {
+      halt(ls, lane, CHIP_STACK_OVERFLOW);
+      break;
+    }
+    ls->stack[lane][++ls->sp[lane]] = ls->pc[lane];
+    ls->pc[lane] = in->nnn;
+    break;
+  case OP_3xkk:
+    if (*vx == in->kk)
+      ls->pc[lane] += 2;
+    break;
+  case OP_4xkk:
+    if (*vx != in->kk)
+      ls->pc[lane] += 2;
+    break;
+  case OP_5xy0:
+    if (*vx == *vy)
+      ls->pc[lane] += 2;
+    break;
+  case OP_9xy0:
+    if (*vx != *vy)
+      ls->pc[lane] += 2;
+    break;
+  case OP_6xkk:
+    *vx = in->kk;
+    break;
+  case OP_7xkk:
+    *vx += in->kk;
+    break;
+  case OP_8xy0:
+    *vx = *vy;
+    break;
+  case OP_8xy1:
+  case OP_8xy2:
+  case OP_8xy3:
+    if (in->op == OP_8xy1)
+      *vx |= *vy;
+    else if (in->op == OP_8xy2)
+      *vx &= *vy;
+    else
+      *vx ^= *vy;
+    if (ls->quirks & VF_RESET)
+      *vf = 0;
+    break;
+  case OP_8xy4:
+    flag = 255 - *vx < *vy;
+    *vx += *vy;
+    *vf = flag;
+    break;
+  case OP_8xy5:
+    flag = *vx >= *vy;
+    *vx -= *vy;
+    *vf = flag;
+    break;
+  case OP_8xy7:
+    flag = *vy >= *vx;
+    *vx = *vy - *vx;
+    *vf = flag;
+    break;
+  case OP_8xy6:
+  case OP_8xyE:
+    src = ls->quirks & SHIFTING ? *vx : *vy;
+    flag = in->op == OP_8xy6 ? src & 0x1 : src >> 7 & 0x1;
+    *vx = in->op == OP_8xy6 ? src >> 1 : (uint8_t)(src << 1);
+    *vf = flag;
+    break;
+  case OP_Annn:
+    ls->index[lane] = in->nnn;
+    break;
+  case OP_Bnnn:
+    ls->pc[lane] =
+        in->nnn + ls->regs[ls->quirks & JUMPING ? in->x : 0][lane];
+    break;
+  case OP_Cxkk:
+    *vx = (uint8_t)(rng_next(&ls->rng[lane]) >> 24) & in->kk;
+    break;
+  case OP_Dxyn:
+    if (ls->quirks & DISPLAY && !ls->vblank[lane]) {
+      halt(ls, lane, CHIP_WAITING_VBLANK);
+      break;
+    }
+    ls->vblank[lane] = 0;
+    draw(ls, lane, in);
+    break;
+  case OP_Ex9E:
+    if (ls->input[lane] & (1 << (*vx & 0xF)))
+      ls->pc[lane] += 2;
+    break;
+  case OP_ExA1:
+    if (!(ls->input[lane] & (1 << (*vx & 0xF))))
+      ls->pc[lane] += 2;
+    break;
+  case OP_Fx07:
+    *vx = ls->dt[lane];
+    break;
+  case OP_Fx0A:
+    if (ls->input[lane])
+      *vx = ls->input_key[lane];
+    else
+      ls->pc[lane] -= 2;
+    break;
+  case OP_Fx15:
+    ls->dt[lane] = *vx;
+    break;
+  case OP_Fx18:
+    ls->st[lane] = *vx;
+    break;
+  case OP_Fx1E:
+    ls->index[lane] += *vx;
+    break;
+  case OP_Fx29:
+    ls->index[lane] = (*vx & 0xF) * 5;
+    break;
+  case OP_Fx33:
+    store(ls, lane, ls->index[lane], *vx / 100);
+    store(ls, lane, ls->index[lane] + 1, *vx / 10 % 10);
+    store(ls, lane, ls->index[lane] + 2, *vx % 10);
+    break;
+  case OP_Fx55:
+    for (uint8_t i = 0; i <= in->x; i++)
+      store(ls, lane, ls->index[lane] + i, ls->regs[i][lane]);
+    if (ls->quirks & MEMORY)
+      ls->index[lane] += in->x + 1;
+    break;
+  case OP_Fx65:
+    for (uint8_t i = 0; i <= in->x; i++)
+      ls->regs[i][lane] = load(ls, lane, ls->index[lane] + i);
+    if (ls->quirks & MEMORY)
+      ls->index[lane] += in->x + 1;
+    break;
+  default:
+    halt(ls, lane, CHIP_UNSUPPORTED_OPCODE);
+    break;
+  }
+}
+
+/* Adds 2 to pc of every lane whose cond8 entry is set. */
+static void vec_skip(LOCKSTEP ls) {
+  Vec two = vec_set16(2);
+
+  FOR_WORDS(i) {
+    Vec cond = vec_widen8(&ls->cond8[i]);
+    vec_store(&ls->pc[i], vec_add16(vec_load(&ls->pc[i]), vec_and(cond, two)));
+  }
+}
+
+/*
+ * Runs the instruction for all lanes of the current group at once. Returns
+ * false for ops that have to go lane by lane.
+ */
+static bool vec_exec(LOCKSTEP ls, const LaneInstr *in) {
+  uint8_t *rx = ls->regs[in->x], *ry = ls->regs[in->y], *rf = ls->regs[0xF];
+  Vec zero = vec_zero(), one = vec_set8(1);
+
+  switch (in->op) {
+  case OP_nop:
+    return true;
+  case OP_1xxx:
+    FOR_WORDS(i) {
+      VEC_PUT(&ls->pc[i], vec_load(&ls->group16[i]), vec_set16(in->nnn));
+    }
+    return true;
+  case OP_Annn:
+    FOR_WORDS(i) {
+      VEC_PUT(&ls->index[i], vec_load(&ls->group16[i]), vec_set16(in->nnn));
+    }
+    return true;
+  case OP_Bnnn: {
+    const uint8_t *base = ls->regs[ls->quirks & JUMPING ? in->x : 0];
+
+    FOR_WORDS(i) {
+      Vec target = vec_add16(vec_set16(in->nnn), vec_zext8(&base[i]));
+      VEC_PUT(&ls->pc[i], vec_load(&ls->group16[i]), target);
+    }
+    return true;
+  }
+  case OP_Fx1E:
+    FOR_WORDS(i) {
+      Vec sum = vec_add16(vec_load(&ls->index[i]), vec_zext8(&rx[i]));
+      VEC_PUT(&ls->index[i], vec_load(&ls->group16[i]), sum);
+    }
+    return true;
+  case OP_Fx29:
+    FOR_WORDS(i) {
+      Vec digit = vec_and(vec_zext8(&rx[i]), vec_set16(0xF));
+      VEC_PUT(&ls->index[i], vec_load(&ls->group16[i]),
+              vec_mul16(digit, vec_set16(5)));
+    }
+    return true;
+  case OP_3xkk:
+  case OP_4xkk:
+  case OP_5xy0:
+  case OP_9xy0:
+    FOR_BYTES(i) {
+      Vec g = vec_load(&ls->group8[i]);
+      Vec rhs = in->op == OP_3xkk || in->op == OP_4xkk ? vec_set8(in->kk)
+                                                       : vec_load(&ry[i]);
+      Vec eq = vec_eq8(vec_load(&rx[i]), rhs);
+
+      vec_store(&ls->cond8[i], in->op == OP_3xkk || in->op == OP_5xy0
+                                   ? vec_and(eq, g)
+                                   : vec_andnot(eq, g));
+    }
+    vec_skip(ls);
+    return true;
+  case OP_Fx07:
+    FOR_BYTES(i) {
+      VEC_PUT(&rx[i], vec_load(&ls->group8[i]),
+              vec_load(&ls->dt[i]));
+    }
+    return true;
+  case OP_Fx15:
+    FOR_BYTES(i) {
+      VEC_PUT(&ls->dt[i], vec_load(&ls->group8[i]),
+              vec_load(&rx[i]));
+    }
+    return true;
+  case OP_Fx18:
+    FOR_BYTES(i) {
+      VEC_PUT(&ls->st[i], vec_load(&ls->group8[i]),
+              vec_load(&rx[i]));
+    }
+    return true;
+  case OP_6xkk:
+    FOR_BYTES(i) {
+      VEC_PUT(&rx[i], vec_load(&ls->group8[i]),
+              vec_set8(in->kk));
+    }
+    return true;
+  case OP_7xkk:
+    FOR_BYTES(i) {
+      Vec sum = vec_add8(vec_load(&rx[i]), vec_set8(in->kk));
+      VEC_PUT(&rx[i], vec_load(&ls->group8[i]), sum);
+    }
+    return true;
+  case OP_8xy0:
+    FOR_BYTES(i) {
+      VEC_PUT(&rx[i], vec_load(&ls->group8[i]),
+              vec_load(&ry[i]));
+    }
+    return true;
+  case OP_8xy1:
+  case OP_8xy2:
+  case OP_8xy3:
+    FOR_BYTES(i) {
+      Vec g = vec_load(&ls->group8[i]);
+      Vec a = vec_load(&rx[i]), b = vec_load(&ry[i]);
+      Vec r = in->op == OP_8xy1   ? vec_or(a, b)
+              : in->op == OP_8xy2 ? vec_and(a, b)
+                                  : vec_xor(a, b);
+
+      VEC_PUT(&rx[i], g, r);
+      if (ls->quirks & VF_RESET)
+        VEC_PUT(&rf[i], g, zero);
+    }
+    return true;
+  case OP_8xy4:
+    FOR_BYTES(i) {
+      Vec g = vec_load(&ls->group8[i]);
+      Vec a = vec_load(&rx[i]), b = vec_load(&ry[i]);
+      Vec sum = vec_add8(a, b);
+      Vec carry = vec_andnot(vec_eq8(vec_adds8(a, b), sum), one);
+
+      VEC_PUT(&rx[i], g, sum);
+      VEC_PUT(&rf[i], g, carry);
+    }
+    return true;
+  case OP_8xy5:
+  case OP_8xy7:
+    FOR_BYTES(i) {
+      Vec g = vec_load(&ls->group8[i]);
+      Vec a = vec_load(&rx[i]), b = vec_load(&ry[i]);
+      Vec lhs = in->op == OP_8xy5 ? a : b, rhs = in->op == OP_8xy5 ? b : a;
+      Vec no_borrow = vec_and(vec_eq8(vec_subs8(rhs, lhs), zero), one);
+
+      VEC_PUT(&rx[i], g, vec_sub8(lhs, rhs));
+      VEC_PUT(&rf[i], g, no_borrow);
+    }
+    return true;
+  case OP_8xy6:
+  case OP_8xyE:
+    FOR_BYTES(i) {
+      Vec g = vec_load(&ls->group8[i]);
+      Vec src = vec_load(ls->quirks & SHIFTING ? &rx[i] : &ry[i]);
+      Vec flag, r;
+
+      if (in->op == OP_8xy6) {
+        flag = vec_and(src, one);
+        r = vec_and(vec_srl16(src, 1), vec_set8(0x7F));
+      } else {
+        flag = vec_and(vec_srl16(src, 7), one);
+        r = vec_add8(src, src);
+      }
+
+      VEC_PUT(&rx[i], g, r);
+      VEC_PUT(&rf[i], g, flag);
+    }
+    return true;
+  default:
+    return false;
+  }
+}
+
+static void exec_group(LOCKSTEP ls, uint16_t pc, uint64_t bits) {
+  uint16_t addr = pc & (MEM_SIZE - 1);
+  uint8_t lane;
+  LaneInstr in;
+
+  if (ls->dirty[addr] || ls->dirty[(addr + 1) & (MEM_SIZE - 1)]) {
+    FOR_LANES(lane, bits) {
+      decode(&in, ls->mem[lane], addr);
+      ls->pc[lane] += 2;
+      lane_exec(ls, lane, &in);
+    }
+    return;
+  }
+
+  decode(&in, ls->image, addr);
+
+  FOR_WORDS(i) {
+    Vec step = vec_and(vec_load(&ls->group16[i]), vec_set16(2));
+    vec_store(&ls->pc[i], vec_add16(vec_load(&ls->pc[i]), step));
+  }
+
+  if (!vec_exec(ls, &in)) {
+    FOR_LANES(lane, bits) {
+      lane_exec(ls, lane, &in);
+    }
+  }
+}
+
+/*
+ * Picks the lowest pc among lanes with budget left, so lanes that fell
+ * behind catch up and merge with the others, and runs every lane sitting
+ * on it. Returns the number of lane steps executed.
+ */
+static uint64_t run_budget(LOCKSTEP ls) {
+  Vec zero = vec_zero();
+  uint64_t done = 0;
+
+  for (;;) {
+    Vec low = vec_set16(0xFFFF), active = zero;
+    uint64_t bits = 0;
+    uint16_t pc;
+
+    FOR_WORDS(i) {
+      Vec idle = vec_eq16(vec_load(&ls->budget[i]), zero);
+
+      low = vec_min16(low, vec_or(vec_load(&ls->pc[i]), idle));
+      active = vec_or(active, vec_xor(idle, vec_set16(0xFFFF)));
+    }
+    if (vec_movemask(active) == 0)
+      return done;
+
+    pc = (uint16_t)_mm_extract_epi16(_mm_minpos_epu16(vec_fold16(low)), 0);
+
+    FOR_BYTES(i) {
+      Vec budget0 = vec_load(&ls->budget[i]);
+      Vec budget1 = vec_load(&ls->budget[i + VEC16]);
+      Vec g0 = vec_andnot(vec_eq16(budget0, zero),
+                          vec_eq16(vec_load(&ls->pc[i]), vec_set16(pc)));
+      Vec g1 =
+          vec_andnot(vec_eq16(budget1, zero),
+                     vec_eq16(vec_load(&ls->pc[i + VEC16]), vec_set16(pc)));
+      Vec g8 = vec_pack16(g0, g1);
+
+      vec_store(&ls->group16[i], g0);
+      vec_store(&ls->group16[i + VEC16], g1);
+      vec_store(&ls->budget[i], vec_add16(budget0, g0));
+      vec_store(&ls->budget[i + VEC16], vec_add16(budget1, g1));
+      vec_store(&ls->group8[i], g8);
+      bits |= (uint64_t)(uint32_t)vec_movemask(g8) << i;
+    }
+
+    done += __builtin_popcountll(bits);
+    exec_group(ls, pc, bits);
+  }
+}
+
+/*
+ * Runs every lane that hasn't halted for the given number of cycles and
+ * returns the total number of lane steps.
+ */
+uint64_t lockstep_run_cycles(LOCKSTEP ls, uint32_t cycles) {
+  uint64_t done = 0;
+
+  while (cycles) {
+    uint16_t chunk = cycles > UINT16_MAX ? UINT16_MAX : (uint16_t)cycles;
+
+    for (uint8_t lane = 0; lane < ls->lanes; lane++)
+      ls->budget[lane] = ls->status[lane] == CHIP_RUNNING ? chunk : 0;
+
+    done += run_budget(ls);
+    cycles -= chunk;
+  }
+
+  return done;
+}
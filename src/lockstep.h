@@ -0,0 +1,35 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include "chip.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define LOCKSTEP_MAX_LANES 64
+
+/*
+ * Runs up to LOCKSTEP_MAX_LANES Chip-8 instances of the same rom side by
+ * side. Lanes sitting on the same pc execute one instruction together;
+ * register, timer and control-flow ops are vectorized, the rest runs lane
+ * by lane.
+ */
+typedef struct lockstep *LOCKSTEP;
+typedef struct LockstepConfig {
+  uint8_t quirks;
+  uint64_t seed;
+  uint8_t lanes;
+} LockstepConfig;
+
+LOCKSTEP lockstep_init(LockstepConfig);
+void lockstep_destroy(LOCKSTEP);
+void lockstep_load_rom(LOCKSTEP, const uint8_t *, size_t);
+uint64_t lockstep_run_cycles(LOCKSTEP, uint32_t);
+void lockstep_update_timers(LOCKSTEP);
+void lockstep_update_input(LOCKSTEP, uint8_t, uint16_t, uint8_t);
+uint8_t lockstep_get_lanes(LOCKSTEP);
+ChipStatus lockstep_get_status(LOCKSTEP, uint8_t);
+uint16_t lockstep_get_pc(LOCKSTEP, uint8_t);
+bool lockstep_is_sound_timer_active(LOCKSTEP, uint8_t);
+const uint64_t *lockstep_get_vram_rows(LOCKSTEP, uint8_t);
+
+#endif
@@ -0,0 +1,170 @@
+#include "media.h"
+#include "chip.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_INPUT_HANDLERS 100
+#define KEYCODE_COUNT 256
+
+/*
+ * Headless media backend. Nothing is drawn or played; key state comes from
+ * an optional input script and advances one virtual frame per
+ * media_read_input call.
+ */
+typedef struct {
+  uint32_t frame;
+  uint8_t keycode;
+  bool down;
+} ScriptEvent;
+
+struct media {
+  InputHandler *ihandlers;
+  uint16_t ihandler_count;
+  uint32_t frame;
+  bool keys[KEYCODE_COUNT];
+  bool prev_keys[KEYCODE_COUNT];
+  ScriptEvent *events;
+  size_t event_count;
+  size_t next_event;
+};
+
+static void media_load_script(MEDIA media, const char *filename);
+
+MEDIA media_init(MediaConfig config) {
+  MEDIA media = calloc(1, sizeof(struct media));
+
+  if (media == NULL)
+    terminate("Failed to allocate memory");
+
+  media->ihandlers = malloc(MAX_INPUT_HANDLERS * sizeof(InputHandler));
+
+  if (media->ihandlers == NULL) {
+    free(media);
+    terminate("Failed to allocate memory");
+  }
+
+  if (config.input_script != NULL)
+    media_load_script(media, config.input_script);
+
+  return media;
+}
+
+/*
+ * Script lines have the form "<frame> <key> <down|up>", where key is a
+ * Chip-8 key in hex. Empty lines and lines starting with '#' are skipped.
+ */
+static void media_load_script(MEDIA media, const char *filename) {
+  FILE *fp = fopen(filename, "r");
+  size_t capacity = 64;
+  char line[128];
+
+  if (!fp) {
+    printf("Failed to open %s\n", filename);
+    exit(EXIT_FAILURE);
+  }
+
+  media->events = malloc(capacity * sizeof(ScriptEvent));
+  if (media->events == NULL) {
+    fclose(fp);
+    terminate("Failed to allocate memory");
+  }
+
+  while (fgets(line, sizeof(line), fp)) {
+    unsigned long frame;
+    unsigned int key;
+    char action[8];
+
+    if (line[0] == '#' || line[0] == '\n')
+      continue;
+
+    if (sscanf(line, "%lu %x %7s", &frame, &key, action) != 3 || key > 0xF ||
+        (strcmp(action, "down") != 0 && strcmp(action, "up") != 0)) {
+      fclose(fp);
+      printf("Malformed input script line: %s", line);
+      exit(EXIT_FAILURE);
+    }
+
+    if (media->event_count == capacity) {
+      ScriptEvent *events;
+
+      capacity *= 2;
+      events = realloc(media->events, capacity * sizeof(ScriptEvent));
+      if (events == NULL) {
+        fclose(fp);
+        terminate("Failed to allocate memory");
+      }
+      media->events = events;
+    }
+
+    media->events[media->event_count++] =
+        (ScriptEvent){.frame = (uint32_t)frame,
+                      .keycode = input_keys[key],
+                      .down = strcmp(action, "down") == 0};
+  }
+
+  fclose(fp);
+}
+
+bool media_is_active(MEDIA media) { return true; }
+
+void media_toggle_fps(MEDIA media) {}
+
+void media_update_screen(MEDIA media, const ChipFrame *frame) {}
+
+void media_start_drawing(MEDIA media) {}
+
+void media_stop_drawing(MEDIA media) {}
+
+void media_destroy(MEDIA media) {
+  free(media->events);
+  free(media->ihandlers);
+  free(media);
+}
+
+void media_read_input(MEDIA media) {
+  InputHandler handler;
+  uint8_t code;
+
+  memcpy(media->prev_keys, media->keys, sizeof(media->keys));
+  while (media->next_event < media->event_count &&
+         media->events[media->next_event].frame <= media->frame) {
+    ScriptEvent *event = &media->events[media->next_event++];
+    media->keys[event->keycode] = event->down;
+  }
+
+  for (uint8_t i = 0; i < media->ihandler_count; i++) {
+    handler = media->ihandlers[i];
+    code = handler.keycode;
+
+    switch (handler.event) {
+    case UP:
+      if (!media->keys[code])
+        handler.handle(&handler);
+      break;
+    case DOWN:
+      if (media->keys[code])
+        handler.handle(&handler);
+      break;
+    case PRESSED:
+      if (media->keys[code] && !media->prev_keys[code])
+        handler.handle(&handler);
+      break;
+    case RELEASED:
+      if (!media->keys[code] && media->prev_keys[code])
+        handler.handle(&handler);
+      break;
+    default:
+      break;
+    }
+  }
+
+  media->frame++;
+}
+
+void media_register_input_handler(MEDIA media, InputHandler handler) {
+  if (media->ihandler_count < MAX_INPUT_HANDLERS) {
+    media->ihandlers[media->ihandler_count++] = handler;
+  }
+}
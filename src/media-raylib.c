@@ -0,0 +1,280 @@
+#include "media.h"
+#include "audio.h"
+#include "chip.h"
+#include "raylib.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHIP_SCREEN_WIDTH 64
+#define CHIP_SCREEN_HEIGHT 32
+#define CHIP_KEYBOARD_SIZE 16
+#define WINDOW_MIN_WIDTH 640
+#define WINDOW_MIN_HEIGHT 320
+#define TARGET_FPS 60
+#define MAX_INPUT_HANDLERS 100
+#define SAMPLE_RATE 44100
+#define AUDIO_BUFFER_DEFAULT 512
+#define RENDER_TIME_FRAMES 60
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+struct media {
+  InputHandler *ihandlers;
+  uint16_t ihandler_count;
+  bool show_fps;
+  /* Indexed by vram_color: background, plane 1, plane 2, both planes. */
+  Color palette[4];
+  AudioStream stream;
+  AUDIO audio;
+
+  MediaRenderer renderer;
+  Texture2D screen;
+  Color *pixels;
+  uint8_t screen_width;
+  uint8_t screen_height;
+  uint32_t vram_generation;
+
+  double render_time;
+  double render_time_avg;
+  uint8_t render_frames;
+};
+
+/*
+ * raylib's stream callback gets no context and there is only one audio
+ * device per process, so the callback finds its voice here.
+ */
+static AUDIO callback_audio;
+
+static Color media_map_color(MediaColor mc);
+static void media_audio_callback(void *buffer, unsigned int frames);
+
+MEDIA media_init(MediaConfig config) {
+  MEDIA media = calloc(1, sizeof(struct media));
+
+  if (media == NULL)
+    terminate("Failed to allocate memory");
+
+  media->ihandlers = malloc(MAX_INPUT_HANDLERS * sizeof(InputHandler));
+
+  if (media->ihandlers == NULL) {
+    free(media);
+    terminate("Failed to allocate memory");
+  }
+
+  media->ihandler_count = 0;
+  media->show_fps = false;
+  media->palette[0] = media_map_color(config.background_color);
+  media->palette[1] = media_map_color(config.foreground_color);
+  media->palette[2] = media_map_color(config.foreground2_color);
+  media->palette[3] = media_map_color(config.blend_color);
+  media->renderer = config.renderer;
+
+  SetConfigFlags(FLAG_WINDOW_RESIZABLE);
+  InitWindow(WINDOW_MIN_WIDTH, WINDOW_MIN_HEIGHT, "Chipo EIGHTo");
+  SetWindowMinSize(WINDOW_MIN_WIDTH, WINDOW_MIN_HEIGHT);
+
+  SetTargetFPS(TARGET_FPS);
+
+  InitAudioDevice();
+  SetAudioStreamBufferSizeDefault(
+      config.audio_buffer ? config.audio_buffer : AUDIO_BUFFER_DEFAULT);
+
+  /* The stream never pauses, the voice renders silence between sounds. */
+  media->audio = audio_init(SAMPLE_RATE, config.sound);
+  callback_audio = media->audio;
+  media->stream = LoadAudioStream(SAMPLE_RATE, 16, 1);
+  SetAudioStreamCallback(media->stream, media_audio_callback);
+  PlayAudioStream(media->stream);
+
+  return media;
+}
+
+static void media_audio_callback(void *buffer, unsigned int frames) {
+  audio_render(callback_audio, buffer, frames);
+}
+
+static Color media_map_color(MediaColor mc) {
+  return (Color){mc.r, mc.g, mc.b, mc.a};
+}
+
+bool media_is_active(MEDIA media) { return !WindowShouldClose(); }
+
+void media_toggle_fps(MEDIA media) { media->show_fps = !media->show_fps; }
+
+static void media_draw_rectangles(MEDIA media, const ChipFrame *frame,
+                                  size_t screen_scaling) {
+  size_t x, y;
+  for (x = 0; x < media->screen_width; x++) {
+    for (y = 0; y < media->screen_height; y++) {
+      uint8_t color = vram_color(frame->vram, frame->planes,
+                                 media->screen_width, media->screen_height,
+                                 x, y);
+
+      if (color) {
+        DrawRectangle(x * screen_scaling, y * screen_scaling, screen_scaling,
+                      screen_scaling, media->palette[color]);
+      }
+    }
+  }
+}
+
+/* Creates the screen texture once the size of the chip screen is known. */
+static void media_load_screen(MEDIA media) {
+  size_t size = (size_t)media->screen_width * media->screen_height;
+  Image image = GenImageColor(media->screen_width, media->screen_height,
+                              media->palette[0]);
+
+  media->screen = LoadTextureFromImage(image);
+  UnloadImage(image);
+  SetTextureFilter(media->screen, TEXTURE_FILTER_POINT);
+
+  media->pixels = malloc(size * sizeof(Color));
+  if (media->pixels == NULL)
+    terminate("Failed to allocate memory");
+}
+
+/*
+ * Converts a row of the frame to pixels a word at a time, looking up the
+ * bits of the planes in the palette.
+ */
+static void media_fill_row(MEDIA media, const ChipFrame *frame, uint8_t y) {
+  size_t pitch = media->screen_width / VRAM_WORD_BITS;
+  size_t plane_words = pitch * media->screen_height;
+  const uint64_t *row = &frame->vram[y * pitch];
+  Color *pixel = &media->pixels[y * media->screen_width];
+
+  for (size_t w = 0; w < pitch; w++) {
+    uint64_t lo = row[w], hi = frame->planes > 1 ? row[w + plane_words] : 0;
+
+    for (int bit = VRAM_WORD_BITS - 1; bit >= 0; bit--)
+      *pixel++ = media->palette[(lo >> bit & 1) | (hi >> bit & 1) << 1];
+  }
+}
+
+/*
+ * Uploads the rows changed since the last frame into the screen texture and
+ * draws it as a single quad. If the frame didn't change the texture is drawn
+ * as it is.
+ */
+static void media_draw_texture(MEDIA media, const ChipFrame *frame,
+                               size_t screen_scaling) {
+  uint8_t width = media->screen_width, height = media->screen_height;
+  uint64_t dirty = frame->dirty_rows;
+
+  if (media->pixels == NULL) {
+    media_load_screen(media);
+    dirty = ~0ull >> (64 - height);
+  } else if (frame->vram_generation == media->vram_generation) {
+    dirty = 0;
+  }
+  media->vram_generation = frame->vram_generation;
+
+  if (dirty) {
+    uint8_t first = __builtin_ctzll(dirty);
+    uint8_t last = 63 - __builtin_clzll(dirty);
+
+    for (size_t y = first; y <= last; y++)
+      if (dirty >> y & 1)
+        media_fill_row(media, frame, y);
+
+    UpdateTextureRec(media->screen,
+                     (Rectangle){0, first, width, last - first + 1},
+                     &media->pixels[first * width]);
+  }
+
+  DrawTexturePro(media->screen, (Rectangle){0, 0, width, height},
+                 (Rectangle){0, 0, width * screen_scaling,
+                             height * screen_scaling},
+                 (Vector2){0, 0}, 0.0f, WHITE);
+}
+
+void media_update_screen(MEDIA media, const ChipFrame *frame) {
+  double start = GetTime();
+
+  media->screen_width = frame->screen_width;
+  media->screen_height = frame->screen_height;
+  float wscaling = (float)GetScreenWidth() / media->screen_width;
+  float hscaling = (float)GetScreenHeight() / media->screen_height;
+  size_t screen_scaling = (size_t)MIN(wscaling, hscaling);
+
+  if (media->renderer == RENDER_TEXTURE)
+    media_draw_texture(media, frame, screen_scaling);
+  else
+    media_draw_rectangles(media, frame, screen_scaling);
+
+  media->render_time += GetTime() - start;
+  if (++media->render_frames == RENDER_TIME_FRAMES) {
+    media->render_time_avg = media->render_time / RENDER_TIME_FRAMES;
+    media->render_time = 0;
+    media->render_frames = 0;
+  }
+}
+
+void media_start_drawing(MEDIA media) {
+  BeginDrawing();
+  ClearBackground(media->palette[0]);
+}
+
+void media_stop_drawing(MEDIA media) {
+  if (media->show_fps) {
+    AudioStats stats = audio_get_stats(media->audio);
+    char text[48];
+
+    DrawFPS(10, 10);
+    snprintf(text, sizeof(text), "%.3f ms/frame",
+             media->render_time_avg * 1e3);
+    DrawText(text, 10, 30, 20, LIME);
+    snprintf(text, sizeof(text), "audio: %u late, %u dropped", stats.late,
+             stats.dropped);
+    DrawText(text, 10, 50, 20, LIME);
+  }
+  EndDrawing();
+}
+
+void media_destroy(MEDIA media) {
+  if (media->pixels != NULL) {
+    UnloadTexture(media->screen);
+    free(media->pixels);
+  }
+  UnloadAudioStream(media->stream);
+  CloseAudioDevice();
+  audio_destroy(media->audio);
+  CloseWindow();
+  free(media->ihandlers);
+  free(media);
+}
+
+void media_read_input(MEDIA media) {
+  InputHandler handler;
+  for (uint8_t i = 0; i < media->ihandler_count; i++) {
+    handler = media->ihandlers[i];
+
+    switch (handler.event) {
+    case UP:
+      if (IsKeyUp(handler.keycode))
+        handler.handle(&handler);
+      break;
+    case DOWN:
+      if (IsKeyDown(handler.keycode))
+        handler.handle(&handler);
+      break;
+    case PRESSED:
+      if (IsKeyPressed(handler.keycode))
+        handler.handle(&handler);
+      break;
+    case RELEASED:
+      if (IsKeyReleased(handler.keycode))
+        handler.handle(&handler);
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+void media_register_input_handler(MEDIA media, InputHandler handler) {
+  if (media->ihandler_count < MAX_INPUT_HANDLERS) {
+    media->ihandlers[media->ihandler_count++] = handler;
+  }
+}
+
@@ -1,6 +1,7 @@
 #ifndef MEDIA_H
 #define MEDIA_H
 
+#include "audio.h"
 #include "chip.h"
 #include <stdbool.h>
 #include <stdint.h>
@@ -9,6 +10,7 @@
 typedef struct media *MEDIA;
 typedef enum { UP, DOWN, PRESSED, RELEASED } MediaBtnEvent;
 typedef enum { TOGGLE_FPS } MediaEvent;
+typedef enum { RENDER_TEXTURE, RENDER_RECTANGLES } MediaRenderer;
 typedef struct InputHandler {
   uint8_t keycode;
   uint8_t alt;
@@ -27,19 +29,23 @@ typedef struct {
 typedef struct {
   MediaColor background_color;
   MediaColor foreground_color;
+  MediaColor foreground2_color;
+  MediaColor blend_color;
   size_t screen_height;
   size_t screen_width;
   size_t screen_scaling;
+  MediaRenderer renderer;
+  AUDIO_QUEUE sound;
+  uint16_t audio_buffer;
+  char *input_script;
 } MediaConfig;
 
 MEDIA media_init(MediaConfig);
 bool media_is_active(MEDIA);
-void media_update_screen(MEDIA, const CHIP8);
+void media_update_screen(MEDIA, const ChipFrame *);
 void media_start_drawing(MEDIA);
 void media_stop_drawing(MEDIA);
 void media_destroy(MEDIA);
-void media_play_sound(MEDIA);
-void media_pause_sound(MEDIA);
 void media_read_input(MEDIA);
 void media_register_input_handler(MEDIA, InputHandler);
 void media_toggle_fps(MEDIA);
@@ -0,0 +1,266 @@
+#include "movie.h"
+#include "chip.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MOVIE_MAGIC "C8MV"
+#define BACKEND_NAME_SIZE 12
+#define MAX_EVENT_SIZE 16
+
+typedef enum { EVENT_INPUT, EVENT_SPEED } MovieEvent;
+
+typedef struct MovieHeader {
+  char magic[4];
+  uint16_t version;
+  uint8_t quirks;
+  uint8_t reserved;
+  uint64_t seed;
+  uint64_t rom_hash;
+  char backend[BACKEND_NAME_SIZE];
+  uint32_t hz;
+  uint32_t frames;
+} MovieHeader;
+
+/*
+ * Every event starts with a varint of the frames since the previous event,
+ * shifted left by one with the event kind in the low bit. An input event
+ * goes on with the keypad mask, two bytes little endian, and the last key
+ * pressed; a speed event with the new rate as a varint.
+ *
+ * A recording writes the events to file as they come and fills in the
+ * frame count of the header when closed. A replay reads the whole file
+ * into data and walks it with next.
+ */
+struct movie {
+  FILE *file;
+  MovieHeader header;
+  MovieFrame last;
+  uint32_t frame;
+  uint32_t event_frame;
+
+  uint8_t *data;
+  size_t size;
+  size_t next;
+};
+
+static uint8_t *put_varint(uint8_t *out, uint32_t value) {
+  while (value >= 0x80) {
+    *out++ = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  *out++ = (uint8_t)value;
+  return out;
+}
+
+/* Returns false if the varint runs past the end of the movie. */
+static bool get_varint(MOVIE movie, uint32_t *value) {
+  unsigned shift = 0;
+  uint8_t byte;
+
+  *value = 0;
+  do {
+    if (movie->next == movie->size || shift > 28)
+      return false;
+    byte = movie->data[movie->next++];
+    *value |= (uint32_t)(byte & 0x7F) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  return true;
+}
+
+static MOVIE movie_init(void) {
+  MOVIE movie = calloc(1, sizeof(struct movie));
+
+  if (movie == NULL)
+    terminate("Failed to allocate memory");
+
+  return movie;
+}
+
+/* Opens path for writing and writes the header. Returns NULL or an error. */
+const char *movie_record(const char *path, const RomData *rom, MovieInfo info,
+                         MOVIE *moviep) {
+  MOVIE movie;
+  FILE *file = fopen(path, "wb");
+
+  if (file == NULL)
+    return "Failed to open the movie file";
+
+  movie = movie_init();
+  movie->file = file;
+  memcpy(movie->header.magic, MOVIE_MAGIC, sizeof(movie->header.magic));
+  movie->header.version = MOVIE_VERSION;
+  movie->header.quirks = info.quirks;
+  movie->header.seed = info.seed;
+  movie->header.rom_hash = hash_bytes(rom->data, rom->size);
+  strncpy(movie->header.backend, info.core->name, BACKEND_NAME_SIZE - 1);
+  movie->header.hz = info.hz;
+  movie->last.hz = info.hz;
+
+  if (fwrite(&movie->header, sizeof(MovieHeader), 1, file) != 1) {
+    fclose(file);
+    free(movie);
+    return "Failed to write the movie file";
+  }
+
+  *moviep = movie;
+  return NULL;
+}
+
+static const ChipCore *find_core(const MovieHeader *header) {
+  char name[BACKEND_NAME_SIZE + 1] = {0};
+
+  memcpy(name, header->backend, BACKEND_NAME_SIZE);
+  return chip_find_core(name);
+}
+
+static const char *check_header(const MovieHeader *header,
+                                const RomData *rom) {
+  if (memcmp(header->magic, MOVIE_MAGIC, sizeof(header->magic)) != 0)
+    return "Not a movie file";
+  if (header->version != MOVIE_VERSION)
+    return "Movie was written by another version";
+  if (find_core(header) == NULL)
+    return "Movie was recorded on an unknown core";
+  if (header->rom_hash != hash_bytes(rom->data, rom->size))
+    return "Movie was recorded with another rom";
+  if (header->hz == 0)
+    return "Movie has no speed";
+
+  return NULL;
+}
+
+/*
+ * Reads the movie and checks it against the rom. On success info holds the
+ * settings the chip must be started with. Returns NULL or an error.
+ */
+const char *movie_replay(const char *path, const RomData *rom,
+                         MovieInfo *info, MOVIE *moviep) {
+  RomData file;
+  const char *error = load_rom_file(path, &file);
+  MOVIE movie;
+
+  if (error != NULL)
+    return "Failed to read the movie file";
+
+  if (file.size < sizeof(MovieHeader)) {
+    free(file.data);
+    return "Not a movie file";
+  }
+
+  movie = movie_init();
+  memcpy(&movie->header, file.data, sizeof(MovieHeader));
+  movie->data = file.data;
+  movie->size = file.size;
+  movie->next = sizeof(MovieHeader);
+  movie->last.hz = movie->header.hz;
+
+  error = check_header(&movie->header, rom);
+  if (error != NULL) {
+    movie_close(movie);
+    return error;
+  }
+
+  *info = (MovieInfo){.seed = movie->header.seed,
+                      .hz = movie->header.hz,
+                      .frames = movie->header.frames,
+                      .quirks = movie->header.quirks,
+                      .core = find_core(&movie->header)};
+  *moviep = movie;
+  return NULL;
+}
+
+static void write_event(MOVIE movie, MovieEvent kind, const MovieFrame *mf) {
+  uint8_t event[MAX_EVENT_SIZE], *out = event;
+
+  out = put_varint(out, (movie->frame - movie->event_frame) << 1 | kind);
+  if (kind == EVENT_INPUT) {
+    *out++ = (uint8_t)mf->input;
+    *out++ = (uint8_t)(mf->input >> 8);
+    *out++ = mf->key;
+  } else {
+    out = put_varint(out, mf->hz);
+  }
+
+  fwrite(event, 1, out - event, movie->file);
+  movie->event_frame = movie->frame;
+}
+
+/* Applies the events of the current frame. Returns false at a bad event. */
+static bool read_events(MOVIE movie) {
+  while (movie->next < movie->size) {
+    size_t start = movie->next;
+    uint32_t tag;
+
+    if (!get_varint(movie, &tag))
+      return false;
+    if (movie->event_frame + (tag >> 1) != movie->frame) {
+      movie->next = start;
+      return true;
+    }
+    movie->event_frame = movie->frame;
+
+    if ((tag & 1) == EVENT_INPUT) {
+      if (movie->size - movie->next < 3)
+        return false;
+      movie->last.input = (uint16_t)(movie->data[movie->next] |
+                                     movie->data[movie->next + 1] << 8);
+      movie->last.key = movie->data[movie->next + 2] & 0xF;
+      movie->next += 3;
+    } else if (!get_varint(movie, &movie->last.hz) || movie->last.hz == 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/*
+ * Called once per frame before the chip runs it. A recording takes the
+ * keypad and speed from mf, a replay overwrites mf with the recorded ones.
+ * Returns false once a replay has run out of frames.
+ */
+bool movie_step(MOVIE movie, MovieFrame *mf) {
+  if (movie->file != NULL) {
+    if (mf->input != movie->last.input || mf->key != movie->last.key)
+      write_event(movie, EVENT_INPUT, mf);
+    if (mf->hz != movie->last.hz)
+      write_event(movie, EVENT_SPEED, mf);
+    movie->last = *mf;
+    movie->frame++;
+    return true;
+  }
+
+  if (movie->next == movie->size && movie->frame >= movie->header.frames)
+    return false;
+  if (!read_events(movie)) {
+    printf("WARNING: movie is broken after frame %u\n", movie->frame);
+    movie->next = movie->size;
+    movie->header.frames = 0;
+    return false;
+  }
+
+  *mf = movie->last;
+  movie->frame++;
+  return true;
+}
+
+/*
+ * Finishes a recording by writing the frame count into the header. Returns
+ * NULL or an error.
+ */
+const char *movie_close(MOVIE movie) {
+  bool ok = true;
+
+  if (movie->file != NULL) {
+    movie->header.frames = movie->frame;
+    ok = fseek(movie->file, 0, SEEK_SET) == 0 &&
+         fwrite(&movie->header, sizeof(MovieHeader), 1, movie->file) == 1;
+    ok &= fclose(movie->file) == 0;
+  }
+
+  free(movie->data);
+  free(movie);
+  return ok ? NULL : "Failed to write the movie file";
+}
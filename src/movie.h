@@ -0,0 +1,36 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include "chip.h"
+#include "utils.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Input movies: a MovieHeader naming the rom, quirks, seed, core and
+ * speed a run started with, followed by the frames where the keypad or the
+ * speed changed. Replaying one from power-on reproduces the run bit for
+ * bit.
+ */
+#define MOVIE_VERSION 1
+
+typedef struct movie *MOVIE;
+typedef struct MovieInfo {
+  uint64_t seed;
+  uint32_t hz;
+  uint32_t frames;
+  uint8_t quirks;
+  const ChipCore *core;
+} MovieInfo;
+typedef struct MovieFrame {
+  uint16_t input;
+  uint8_t key;
+  uint32_t hz;
+} MovieFrame;
+
+const char *movie_record(const char *, const RomData *, MovieInfo, MOVIE *);
+const char *movie_replay(const char *, const RomData *, MovieInfo *, MOVIE *);
+bool movie_step(MOVIE, MovieFrame *);
+const char *movie_close(MOVIE);
+
+#endif
@@ -0,0 +1,246 @@
+#ifndef OPCODES_H
+#define OPCODES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Every handler a core implements, in table order. The names match the
+ * opcode_* functions of the core, so the same list builds the handler
+ * table, the threaded dispatch labels and the generated opcode table.
+ */
+#define CHIP8_OPS(X)                                                           \
+  X(unsupported)                                                               \
+  X(nop)                                                                       \
+  X(00E0)                                                                      \
+  X(00EE)                                                                      \
+  X(1xxx)                                                                      \
+  X(2nnn)                                                                      \
+  X(3xkk)                                                                      \
+  X(4xkk)                                                                      \
+  X(5xy0)                                                                      \
+  X(6xkk)                                                                      \
+  X(7xkk)                                                                      \
+  X(8xy0)                                                                      \
+  X(8xy1)                                                                      \
+  X(8xy2)                                                                      \
+  X(8xy3)                                                                      \
+  X(8xy4)                                                                      \
+  X(8xy5)                                                                      \
+  X(8xy6)                                                                      \
+  X(8xy7)                                                                      \
+  X(8xyE)                                                                      \
+  X(9xy0)                                                                      \
+  X(Annn)                                                                      \
+  X(Bnnn)                                                                      \
+  X(Cxkk)                                                                      \
+  X(Dxyn)                                                                      \
+  X(Ex9E)                                                                      \
+  X(ExA1)                                                                      \
+  X(Fx07)                                                                      \
+  X(Fx0A)                                                                      \
+  X(Fx15)                                                                      \
+  X(Fx18)                                                                      \
+  X(Fx1E)                                                                      \
+  X(Fx29)                                                                      \
+  X(Fx33)                                                                      \
+  X(Fx55)                                                                      \
+  X(Fx65)
+
+#define SUPER_CHIP_OPS(X)                                                      \
+  CHIP8_OPS(X)                                                                 \
+  X(00FF)                                                                      \
+  X(00FE)                                                                      \
+  X(00FB)                                                                      \
+  X(00FC)                                                                      \
+  X(00FD)                                                                      \
+  X(00Cn)                                                                      \
+  X(Dxy0)                                                                      \
+  X(Fx30)                                                                      \
+  X(Fx75)                                                                      \
+  X(Fx85)                                                                      \
+  X(F002)                                                                      \
+  X(Fx3A)
+
+#define XO_CHIP_OPS(X)                                                         \
+  SUPER_CHIP_OPS(X)                                                            \
+  X(00Dn)                                                                      \
+  X(5xy2)                                                                      \
+  X(5xy3)                                                                      \
+  X(F000)                                                                      \
+  X(Fn01)
+
+#if defined(CHIP_XO_CHIP)
+#define CHIP_OPS(X) XO_CHIP_OPS(X)
+#elif defined(CHIP_SUPER_CHIP)
+#define CHIP_OPS(X) SUPER_CHIP_OPS(X)
+#else
+#define CHIP_OPS(X) CHIP8_OPS(X)
+#endif
+
+#define OP_ENUM(name) OP_##name,
+typedef enum { CHIP_OPS(OP_ENUM) OP_COUNT } ChipOp;
+#undef OP_ENUM
+
+static inline ChipOp opcode_classify(uint16_t opcode) {
+  switch (opcode & 0xF000) {
+  case 0x0000:
+    switch (opcode & 0x00FF) {
+    case 0x00E0:
+      return OP_00E0;
+    case 0x00EE:
+      return OP_00EE;
+#ifdef CHIP_SUPER_CHIP
+    case 0x00FF:
+      return OP_00FF;
+    case 0x00FE:
+      return OP_00FE;
+    case 0x00FB:
+      return OP_00FB;
+    case 0x00FC:
+      return OP_00FC;
+    case 0x00FD:
+      return OP_00FD;
+#ifdef CHIP_XO_CHIP
+    default:
+      if ((opcode & 0x00F0) == 0x00D0)
+        return OP_00Dn;
+      return (opcode & 0x00F0) == 0x00C0 ? OP_00Cn : OP_nop;
+#else
+    default:
+      return (opcode & 0x00F0) == 0x00C0 ? OP_00Cn : OP_nop;
+#endif
+#else
+    default:
+      return OP_nop;
+#endif
+    }
+  case 0x1000:
+    return OP_1xxx;
+  case 0x2000:
+    return OP_2nnn;
+  case 0x3000:
+    return OP_3xkk;
+  case 0x4000:
+    return OP_4xkk;
+  case 0x5000:
+#ifdef CHIP_XO_CHIP
+    switch (opcode & 0xF) {
+    case 0x0:
+      return OP_5xy0;
+    case 0x2:
+      return OP_5xy2;
+    case 0x3:
+      return OP_5xy3;
+    default:
+      return OP_nop;
+    }
+#else
+    return (opcode & 0xF) == 0 ? OP_5xy0 : OP_nop;
+#endif
+  case 0x6000:
+    return OP_6xkk;
+  case 0x7000:
+    return OP_7xkk;
+  case 0x8000:
+    switch (opcode & 0xF) {
+    case 0x0:
+      return OP_8xy0;
+    case 0x1:
+      return OP_8xy1;
+    case 0x2:
+      return OP_8xy2;
+    case 0x3:
+      return OP_8xy3;
+    case 0x4:
+      return OP_8xy4;
+    case 0x5:
+      return OP_8xy5;
+    case 0x6:
+      return OP_8xy6;
+    case 0x7:
+      return OP_8xy7;
+    case 0xE:
+      return OP_8xyE;
+    default:
+      return OP_unsupported;
+    }
+  case 0x9000:
+    return (opcode & 0xF) == 0 ? OP_9xy0 : OP_nop;
+  case 0xA000:
+    return OP_Annn;
+  case 0xB000:
+    return OP_Bnnn;
+  case 0xC000:
+    return OP_Cxkk;
+  case 0xD000:
+#ifdef CHIP_SUPER_CHIP
+    return (opcode & 0xF) == 0 ? OP_Dxy0 : OP_Dxyn;
+#else
+    return OP_Dxyn;
+#endif
+  case 0xE000:
+    switch (opcode & 0xFF) {
+    case 0x009E:
+      return OP_Ex9E;
+    case 0x00A1:
+      return OP_ExA1;
+    default:
+      return OP_unsupported;
+    }
+  case 0xF000:
+    switch (opcode & 0xFF) {
+    case 0x0007:
+      return OP_Fx07;
+    case 0x000A:
+      return OP_Fx0A;
+    case 0x0015:
+      return OP_Fx15;
+    case 0x0018:
+      return OP_Fx18;
+    case 0x001E:
+      return OP_Fx1E;
+    case 0x0029:
+      return OP_Fx29;
+    case 0x0033:
+      return OP_Fx33;
+    case 0x0055:
+      return OP_Fx55;
+    case 0x0065:
+      return OP_Fx65;
+#ifdef CHIP_SUPER_CHIP
+    case 0x0030:
+      return OP_Fx30;
+    case 0x0075:
+      return OP_Fx75;
+    case 0x0085:
+      return OP_Fx85;
+    case 0x0002:
+      return opcode & 0x0F00 ? OP_unsupported : OP_F002;
+    case 0x003A:
+      return OP_Fx3A;
+#endif
+#ifdef CHIP_XO_CHIP
+    case 0x0000:
+      return opcode & 0x0F00 ? OP_unsupported : OP_F000;
+    case 0x0001:
+      return OP_Fn01;
+#endif
+    default:
+      return OP_unsupported;
+    }
+  default:
+    return OP_unsupported;
+  }
+}
+
+/* Ops that can stop the machine, see ChipStatus. */
+static inline bool opcode_halts(ChipOp op) {
+#ifdef CHIP_SUPER_CHIP
+  if (op == OP_00FD || op == OP_Dxy0)
+    return true;
+#endif
+  return op == OP_unsupported || op == OP_2nnn || op == OP_Dxyn;
+}
+
+#endif
@@ -0,0 +1,186 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "args.h"
+#include "chip.h"
+#include "config.h"
+#include "rompack.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LINE_SIZE 4096
+
+typedef struct {
+  PackRom *roms;
+  size_t count;
+  size_t capacity;
+} PackList;
+
+Config *parse_args_into_config(int argc, char **argv) {
+  Config *config = config_init();
+
+  ArgParserOptions *options = args_init_options(2);
+  args_add_options(
+      options, 2,
+      (ArgParserOption){.lng = "output",
+                        .shrt = 'o',
+                        .description = "the rom pack to write",
+                        .parse = &parse_string_arg_value,
+                        .set = &config_set_output},
+      (ArgParserOption){.lng = "help",
+                        .shrt = 'h',
+                        .description = "display this help and exit",
+                        .parse = &display_help_message,
+                        .set = NULL});
+
+  args_parse(options, argc, argv, config);
+  args_destroy(options);
+
+  return config;
+}
+
+static uint8_t parse_quirks(char *value) {
+  uint8_t quirks = 0;
+
+  for (char *name = strtok(value, ","); name; name = strtok(NULL, ",")) {
+    uint8_t *quirk = parse_chip_quirk_arg_value(NULL, name, NULL);
+    quirks |= *quirk;
+    free(quirk);
+  }
+
+  return quirks;
+}
+
+/*
+ * Parses "<rom> [core=name] [quirks=a,b]", backend= being read as core= like
+ * in batch lists, and reads the rom. The rom is stored under its path as
+ * written on the line. Roms without a core= get the one picked from the
+ * rom, so runners can skip the detection.
+ */
+static void parse_rom(PackRom *rom, char *line, size_t lineno) {
+  char *fields[3];
+  size_t count = 0;
+  const char *error;
+  RomData rd;
+
+  for (char *tok = strtok(line, " \t\r\n"); tok && count < 3;
+       tok = strtok(NULL, " \t\r\n"))
+    fields[count++] = tok;
+
+  memset(rom, 0, sizeof(PackRom));
+  rom->name = strdup(fields[0]);
+  if (rom->name == NULL)
+    terminate("Failed to allocate memory");
+
+  for (size_t i = 1; i < count; i++) {
+    char *value = strchr(fields[i], '=');
+
+    if (value == NULL) {
+      fprintf(stderr, "Expected key=value on line %zu: %s\n", lineno,
+              fields[i]);
+      exit(EXIT_FAILURE);
+    }
+    *value++ = '\0';
+
+    if (strcmp(fields[i], "quirks") == 0) {
+      rom->quirks = parse_quirks(value);
+      rom->quirks_set = true;
+    } else if (strcmp(fields[i], "core") == 0 ||
+               strcmp(fields[i], "backend") == 0) {
+      rom->core = chip_find_core(value);
+      if (rom->core == NULL) {
+        fprintf(stderr, "Unknown core on line %zu: %s\n", lineno, value);
+        exit(EXIT_FAILURE);
+      }
+    } else {
+      fprintf(stderr, "Unknown setting on line %zu: %s\n", lineno, fields[i]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if ((error = load_rom_file(rom->name, &rd)) != NULL) {
+    fprintf(stderr, "%s: %s\n", rom->name, error);
+    exit(EXIT_FAILURE);
+  }
+
+  if (rom->core == NULL)
+    rom->core = chip_detect_core(rd.data, rd.size);
+  if (!chip_rom_fits(rom->core, rd.size)) {
+    fprintf(stderr, "%s: rom does not fit into memory\n", rom->name);
+    exit(EXIT_FAILURE);
+  }
+
+  rom->data = rd.data;
+  rom->size = rd.size;
+}
+
+static PackList read_rom_list(const char *filename) {
+  PackList list = {.count = 0, .capacity = 64};
+  char line[MAX_LINE_SIZE];
+  size_t lineno = 0;
+  FILE *fp = fopen(filename, "r");
+
+  if (!fp) {
+    printf("Failed to open %s\n", filename);
+    exit(EXIT_FAILURE);
+  }
+
+  list.roms = malloc(list.capacity * sizeof(PackRom));
+  if (list.roms == NULL)
+    terminate("Failed to allocate memory");
+
+  while (fgets(line, sizeof(line), fp)) {
+    char *start = line + strspn(line, " \t");
+
+    lineno++;
+    if (*start == '#' || *start == '\n' || *start == '\r' || *start == '\0')
+      continue;
+
+    if (list.count == list.capacity) {
+      PackRom *roms;
+
+      list.capacity *= 2;
+      roms = realloc(list.roms, list.capacity * sizeof(PackRom));
+      if (roms == NULL)
+        terminate("Failed to allocate memory");
+      list.roms = roms;
+    }
+
+    parse_rom(&list.roms[list.count++], start, lineno);
+  }
+
+  fclose(fp);
+
+  return list;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2)
+    terminate("Usage: chipo8o-pack [LIST] --output=FILE [OPTION]...");
+
+  Config *config = parse_args_into_config(argc, argv);
+  const char *error;
+  size_t bytes = 0;
+
+  if (config->output == NULL)
+    terminate("--output is required");
+
+  PackList list = read_rom_list(argv[1]);
+
+  if ((error = rompack_write(config->output, list.roms, list.count)) != NULL)
+    terminate(error);
+
+  for (size_t i = 0; i < list.count; i++) {
+    bytes += list.roms[i].size;
+    free((char *)list.roms[i].name);
+    free((uint8_t *)list.roms[i].data);
+  }
+
+  fprintf(stderr, "%zu roms, %zu bytes\n", list.count, bytes);
+
+  free(list.roms);
+  free(config);
+
+  return 0;
+}
@@ -0,0 +1,148 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "pool.h"
+#include "utils.h"
+#include <pthread.h>
+#include <unistd.h>
+
+/*
+ * Work-stealing pool for a fixed set of independent jobs. Every worker owns
+ * a contiguous range of job indices and takes jobs from its front. A worker
+ * that runs dry steals the back half of the largest remaining range, so
+ * long running jobs don't leave the other cores idle.
+ */
+typedef struct {
+  pthread_mutex_t lock;
+  size_t head;
+  size_t tail;
+} WorkRange;
+
+typedef struct {
+  WorkRange *ranges;
+  unsigned count;
+  PoolJob job;
+  void *ctx;
+} Pool;
+
+typedef struct {
+  Pool *pool;
+  unsigned id;
+} Worker;
+
+unsigned pool_default_threads(void) {
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+  return n > 0 ? (unsigned)n : 1;
+}
+
+static bool take(WorkRange *range, size_t *job) {
+  bool found = false;
+
+  pthread_mutex_lock(&range->lock);
+  if (range->head < range->tail) {
+    *job = range->head++;
+    found = true;
+  }
+  pthread_mutex_unlock(&range->lock);
+
+  return found;
+}
+
+static bool steal(Pool *pool, unsigned id) {
+  WorkRange *own = &pool->ranges[id];
+  WorkRange *victim = NULL;
+  size_t best = 0, from = 0, to = 0;
+
+  for (unsigned i = 0; i < pool->count; i++) {
+    WorkRange *range = &pool->ranges[i];
+    size_t left;
+
+    if (i == id)
+      continue;
+    pthread_mutex_lock(&range->lock);
+    left = range->tail - range->head;
+    pthread_mutex_unlock(&range->lock);
+
+    if (left > best) {
+      best = left;
+      victim = range;
+    }
+  }
+
+  if (victim == NULL)
+    return false;
+
+  pthread_mutex_lock(&victim->lock);
+  if (victim->head < victim->tail) {
+    to = victim->tail;
+    from = victim->head + (victim->tail - victim->head) / 2;
+    victim->tail = from;
+  }
+  pthread_mutex_unlock(&victim->lock);
+
+  if (from == to)
+    return steal(pool, id);
+
+  pthread_mutex_lock(&own->lock);
+  own->head = from;
+  own->tail = to;
+  pthread_mutex_unlock(&own->lock);
+
+  return true;
+}
+
+static void *worker_main(void *arg) {
+  Worker *worker = arg;
+  Pool *pool = worker->pool;
+  size_t job;
+
+  do {
+    while (take(&pool->ranges[worker->id], &job))
+      pool->job(job, pool->ctx);
+  } while (steal(pool, worker->id));
+
+  return NULL;
+}
+
+/* Runs job(i, ctx) for every i below count on up to threads threads. */
+void pool_run(size_t count, unsigned threads, PoolJob job, void *ctx) {
+  Pool pool = {.count = threads, .job = job, .ctx = ctx};
+  pthread_t *ids;
+  Worker *workers;
+
+  if (count == 0)
+    return;
+  if (threads == 0)
+    threads = pool_default_threads();
+  if (threads > count)
+    threads = (unsigned)count;
+  pool.count = threads;
+
+  pool.ranges = malloc(threads * sizeof(WorkRange));
+  workers = malloc(threads * sizeof(Worker));
+  ids = malloc(threads * sizeof(pthread_t));
+  if (pool.ranges == NULL || workers == NULL || ids == NULL)
+    terminate("Failed to allocate memory");
+
+  for (unsigned i = 0; i < threads; i++) {
+    pthread_mutex_init(&pool.ranges[i].lock, NULL);
+    pool.ranges[i].head = count * i / threads;
+    pool.ranges[i].tail = count * (i + 1) / threads;
+    workers[i] = (Worker){.pool = &pool, .id = i};
+  }
+
+  for (unsigned i = 1; i < threads; i++)
+    if (pthread_create(&ids[i], NULL, worker_main, &workers[i]) != 0)
+      terminate("Failed to start worker thread");
+
+  worker_main(&workers[0]);
+
+  for (unsigned i = 1; i < threads; i++)
+    pthread_join(ids[i], NULL);
+
+  for (unsigned i = 0; i < threads; i++)
+    pthread_mutex_destroy(&pool.ranges[i].lock);
+  free(pool.ranges);
+  free(workers);
+  free(ids);
+}
@@ -0,0 +1,11 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdlib.h>
+
+typedef void (*PoolJob)(size_t, void *);
+
+unsigned pool_default_threads(void);
+void pool_run(size_t, unsigned, PoolJob, void *);
+
+#endif
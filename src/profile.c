@@ -0,0 +1,115 @@
+#include "profile.h"
+#include <stdlib.h>
+
+#define TOP_ADDRESSES 16
+
+typedef struct ProfileEntry {
+  uint16_t key;
+  uint64_t count;
+} ProfileEntry;
+
+static int compare_entries(const void *a, const void *b) {
+  const ProfileEntry *ea = a, *eb = b;
+
+  if (ea->count != eb->count)
+    return ea->count < eb->count ? 1 : -1;
+  return ea->key - eb->key;
+}
+
+/* Fills entries with the counters that aren't zero, busiest first. */
+static size_t sort_counts(const uint64_t *counts, size_t size,
+                          ProfileEntry *entries) {
+  size_t used = 0;
+
+  for (size_t i = 0; i < size; i++)
+    if (counts[i])
+      entries[used++] = (ProfileEntry){.key = (uint16_t)i, .count = counts[i]};
+
+  qsort(entries, used, sizeof(ProfileEntry), &compare_entries);
+  return used;
+}
+
+static uint64_t sum_counts(const uint64_t *counts, size_t size) {
+  uint64_t total = 0;
+
+  for (size_t i = 0; i < size; i++)
+    total += counts[i];
+  return total;
+}
+
+static void print_addresses(const char *title, const uint64_t *counts,
+                            FILE *out) {
+  ProfileEntry entries[MEM_SIZE];
+  uint64_t total = sum_counts(counts, MEM_SIZE);
+  size_t used = sort_counts(counts, MEM_SIZE, entries);
+
+  fprintf(out, "%s: %llu in %zu addresses\n", title,
+          (unsigned long long)total, used);
+  for (size_t i = 0; i < used && i < TOP_ADDRESSES; i++)
+    fprintf(out, "  %03X %14llu %5.1f%%\n", entries[i].key,
+            (unsigned long long)entries[i].count,
+            100.0 * entries[i].count / total);
+}
+
+void profile_print(const ChipProfile *profile, FILE *out) {
+  ProfileEntry entries[PROFILE_OPS];
+  uint64_t total = sum_counts(profile->ops, profile->op_count);
+  size_t used = sort_counts(profile->ops, profile->op_count, entries);
+
+  fprintf(out, "instructions: %llu\n", (unsigned long long)total);
+  for (size_t i = 0; i < used; i++)
+    fprintf(out, "  %-11s %14llu %5.1f%%\n", profile->op_names[entries[i].key],
+            (unsigned long long)entries[i].count,
+            100.0 * entries[i].count / total);
+
+  print_addresses("hot addresses", profile->pcs, out);
+  print_addresses("memory reads", profile->reads, out);
+  print_addresses("memory writes", profile->writes, out);
+}
+
+/* Writes "kind,key,count" rows. Returns NULL or an error. */
+const char *profile_write_csv(const ChipProfile *profile, const char *path) {
+  FILE *file = fopen(path, "w");
+  const struct {
+    const char *kind;
+    const uint64_t *counts;
+  } maps[] = {{"pc", profile->pcs},
+              {"read", profile->reads},
+              {"write", profile->writes}};
+
+  if (file == NULL)
+    return "Failed to open the profile file";
+
+  fprintf(file, "kind,key,count\n");
+  for (uint8_t op = 0; op < profile->op_count; op++)
+    if (profile->ops[op])
+      fprintf(file, "op,%s,%llu\n", profile->op_names[op],
+              (unsigned long long)profile->ops[op]);
+
+  for (size_t m = 0; m < sizeof(maps) / sizeof(maps[0]); m++)
+    for (uint16_t addr = 0; addr < MEM_SIZE; addr++)
+      if (maps[m].counts[addr])
+        fprintf(file, "%s,%03X,%llu\n", maps[m].kind, addr,
+                (unsigned long long)maps[m].counts[addr]);
+
+  if (fclose(file) != 0)
+    return "Failed to write the profile file";
+  return NULL;
+}
+
+/* The profile of a rom is written next to it, as <rom>.profile.csv. */
+void profile_csv_path(char *path, size_t size, const char *rom) {
+  snprintf(path, size, "%s.profile.csv", rom);
+}
+
+/* Prints the report and writes the CSV to path. */
+void profile_dump(const ChipProfile *profile, const char *path) {
+  const char *error;
+
+  profile_print(profile, stdout);
+  error = profile_write_csv(profile, path);
+  if (error != NULL)
+    printf("WARNING: %s\n", error);
+  else
+    printf("Profile written to %s\n", path);
+}
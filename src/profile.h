@@ -0,0 +1,18 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "chip.h"
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * Reports of the execution counters of a profile build, see ChipProfile.
+ * The text report lists the busiest handlers, addresses and memory bytes;
+ * the CSV holds every counter that isn't zero.
+ */
+void profile_print(const ChipProfile *, FILE *);
+const char *profile_write_csv(const ChipProfile *, const char *);
+void profile_csv_path(char *, size_t, const char *);
+void profile_dump(const ChipProfile *, const char *);
+
+#endif
@@ -0,0 +1,302 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "rewind.h"
+#include "utils.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define STATE_WORDS (sizeof(ChipState) / sizeof(uint64_t))
+#define MAX_ENCODED (STATE_WORDS * 10 + 16)
+#define KEYFRAME_INTERVAL 60
+#define BYTES_PER_RECORD 40
+#define PUSH_TIME_FRAMES 60
+
+typedef struct RewindRecord {
+  uint32_t offset;
+  uint32_t size;
+  bool key;
+} RewindRecord;
+
+/*
+ * Snapshots live in a byte arena used as a ring: they are written one after
+ * another at head and wrap around to the start when the end is reached.
+ * records is a ring of the same snapshots, oldest at first. key always
+ * holds the keyframe of the newest group, the one new snapshots are taken
+ * against.
+ */
+struct rewind {
+  uint8_t *arena;
+  size_t arena_size;
+  size_t head;
+  size_t bytes;
+  size_t budget;
+
+  RewindRecord *records;
+  uint32_t capacity;
+  uint32_t first;
+  uint32_t count;
+  uint32_t group_frames;
+
+  uint64_t key[STATE_WORDS];
+  uint64_t words[STATE_WORDS];
+  uint8_t encoded[MAX_ENCODED];
+
+  double push_time;
+  double push_time_sum;
+  uint8_t push_frames;
+};
+
+/*
+ * Every snapshot needs a record, which are sized for snapshots averaging
+ * BYTES_PER_RECORD bytes. The rest of the budget is the arena.
+ */
+REWIND rewind_init(size_t budget) {
+  REWIND rw = calloc(1, sizeof(struct rewind));
+  uint32_t capacity = budget / BYTES_PER_RECORD;
+
+  if (rw == NULL)
+    terminate("Failed to allocate memory");
+
+  rw->budget = budget;
+  rw->capacity = capacity ? capacity : 1;
+  rw->arena_size = budget - capacity * sizeof(RewindRecord);
+  rw->records = calloc(rw->capacity, sizeof(RewindRecord));
+  rw->arena = malloc(rw->arena_size);
+  if (rw->records == NULL || rw->arena == NULL)
+    terminate("Failed to allocate memory");
+
+  return rw;
+}
+
+void rewind_destroy(REWIND rw) {
+  free(rw->arena);
+  free(rw->records);
+  free(rw);
+}
+
+void rewind_clear(REWIND rw) {
+  rw->first = 0;
+  rw->count = 0;
+  rw->head = 0;
+  rw->bytes = 0;
+  rw->group_frames = 0;
+}
+
+static RewindRecord *record_at(REWIND rw, uint32_t i) {
+  return &rw->records[(rw->first + i) % rw->capacity];
+}
+
+static uint8_t *put_varint(uint8_t *out, size_t value) {
+  while (value >= 0x80) {
+    *out++ = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  *out++ = (uint8_t)value;
+  return out;
+}
+
+static const uint8_t *get_varint(const uint8_t *in, size_t *value) {
+  unsigned shift = 0;
+
+  *value = 0;
+  do {
+    *value |= (size_t)(*in & 0x7F) << shift;
+    shift += 7;
+  } while (*in++ & 0x80);
+  return in;
+}
+
+/*
+ * Encodes words XOR base as pairs of a run of zero words and a run of
+ * literal words, each run length a varint. A NULL base is all zeros.
+ */
+static size_t encode(const uint64_t *words, const uint64_t *base,
+                     uint8_t *out) {
+  uint8_t *start = out;
+  size_t i = 0;
+
+  while (i < STATE_WORDS) {
+    size_t zeros = i, literals;
+
+    while (i < STATE_WORDS && words[i] == (base ? base[i] : 0))
+      i++;
+    zeros = i - zeros;
+    literals = i;
+    while (i < STATE_WORDS && words[i] != (base ? base[i] : 0))
+      i++;
+    literals = i - literals;
+
+    out = put_varint(out, zeros);
+    out = put_varint(out, literals);
+    for (size_t j = i - literals; j < i; j++) {
+      uint64_t delta = words[j] ^ (base ? base[j] : 0);
+
+      memcpy(out, &delta, sizeof(delta));
+      out += sizeof(delta);
+    }
+  }
+
+  return out - start;
+}
+
+/* XORs an encoded snapshot onto words. */
+static void decode(const uint8_t *in, uint64_t *words) {
+  size_t i = 0;
+
+  while (i < STATE_WORDS) {
+    size_t zeros, literals;
+
+    in = get_varint(in, &zeros);
+    in = get_varint(in, &literals);
+    i += zeros;
+    for (size_t j = 0; j < literals; j++, i++) {
+      uint64_t delta;
+
+      memcpy(&delta, in, sizeof(delta));
+      words[i] ^= delta;
+      in += sizeof(delta);
+    }
+  }
+}
+
+/* Drops the oldest group, its keyframe and every snapshot taken against it. */
+static void evict_group(REWIND rw) {
+  do {
+    rw->bytes -= record_at(rw, 0)->size;
+    rw->first = (rw->first + 1) % rw->capacity;
+    rw->count--;
+  } while (rw->count > 0 && !record_at(rw, 0)->key);
+
+  if (rw->count == 0)
+    rewind_clear(rw);
+}
+
+/* Returns where size bytes fit in the arena, or -1 if they don't. */
+static long find_space(REWIND rw, size_t size) {
+  RewindRecord *oldest, *newest;
+
+  if (rw->count == 0)
+    return size <= rw->arena_size ? 0 : -1;
+  if (rw->count == rw->capacity)
+    return -1;
+
+  oldest = record_at(rw, 0);
+  newest = record_at(rw, rw->count - 1);
+
+  if (newest->offset >= oldest->offset) {
+    if (rw->head + size <= rw->arena_size)
+      return (long)rw->head;
+    return size <= oldest->offset ? 0 : -1;
+  }
+
+  return rw->head + size <= oldest->offset ? (long)rw->head : -1;
+}
+
+/*
+ * Stores the encoded snapshot, evicting old groups as needed. Returns false
+ * if it only fits by evicting the group it belongs to.
+ */
+static bool store(REWIND rw, size_t size, bool key) {
+  RewindRecord *record;
+  long offset;
+
+  while ((offset = find_space(rw, size)) < 0) {
+    bool newest_group = true;
+
+    for (uint32_t i = 1; i < rw->count && newest_group; i++)
+      newest_group = !record_at(rw, i)->key;
+    if (rw->count == 0 || (newest_group && !key))
+      return false;
+    evict_group(rw);
+  }
+
+  memcpy(rw->arena + offset, rw->encoded, size);
+  record = record_at(rw, rw->count++);
+  *record = (RewindRecord){
+      .offset = (uint32_t)offset, .size = (uint32_t)size, .key = key};
+  rw->head = offset + size;
+  rw->bytes += size;
+  return true;
+}
+
+static double elapsed_seconds(struct timespec *start, struct timespec *end) {
+  return (double)(end->tv_sec - start->tv_sec) +
+         (double)(end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/*
+ * Takes a snapshot of the chip. Every KEYFRAME_INTERVAL frames, or when the
+ * current group would have to be evicted for it, a new group is started.
+ */
+void rewind_push(REWIND rw, CHIP8 chip) {
+  struct timespec start, end;
+  bool key = rw->count == 0 || rw->group_frames >= KEYFRAME_INTERVAL;
+  size_t size;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  chip_save_state(chip, (ChipState *)rw->words);
+
+  if (!key && !store(rw, encode(rw->words, rw->key, rw->encoded), false))
+    key = true;
+  if (key) {
+    size = encode(rw->words, NULL, rw->encoded);
+    if (!store(rw, size, true)) {
+      rewind_clear(rw);
+      if (!store(rw, size, true))
+        return;
+    }
+    memcpy(rw->key, rw->words, sizeof(rw->key));
+    rw->group_frames = 0;
+  }
+  rw->group_frames++;
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  rw->push_time_sum += elapsed_seconds(&start, &end);
+  if (++rw->push_frames == PUSH_TIME_FRAMES) {
+    rw->push_time = rw->push_time_sum / PUSH_TIME_FRAMES;
+    rw->push_time_sum = 0;
+    rw->push_frames = 0;
+  }
+}
+
+/*
+ * Drops the newest snapshot and loads the one before it into the chip.
+ * Returns false, leaving the chip alone, when there is nothing to go back
+ * to.
+ */
+bool rewind_pop(REWIND rw, CHIP8 chip) {
+  RewindRecord *record;
+  uint32_t key_index;
+
+  if (rw->count < 2)
+    return false;
+
+  record = record_at(rw, --rw->count);
+  rw->bytes -= record->size;
+  rw->head = record->offset;
+
+  /* Walk back to the keyframe of the snapshot that is now the newest. */
+  for (key_index = rw->count - 1; !record_at(rw, key_index)->key; key_index--)
+    ;
+  rw->group_frames = rw->count - key_index;
+  if (record->key) {
+    memset(rw->key, 0, sizeof(rw->key));
+    decode(rw->arena + record_at(rw, key_index)->offset, rw->key);
+  }
+
+  memcpy(rw->words, rw->key, sizeof(rw->words));
+  record = record_at(rw, rw->count - 1);
+  if (!record->key)
+    decode(rw->arena + record->offset, rw->words);
+
+  return chip_load_state(chip, (ChipState *)rw->words);
+}
+
+RewindStats rewind_get_stats(REWIND rw) {
+  return (RewindStats){.frames = rw->count,
+                       .bytes = rw->bytes,
+                       .budget = rw->budget,
+                       .push_time = rw->push_time};
+}
@@ -0,0 +1,30 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include "chip.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * History of chip states for rewinding, one snapshot per frame within a
+ * fixed memory budget. Snapshots are stored as the XOR against the keyframe
+ * of their group, with runs of unchanged words left out. When the budget is
+ * used up the oldest groups go first.
+ */
+typedef struct rewind *REWIND;
+typedef struct RewindStats {
+  uint32_t frames;
+  size_t bytes;
+  size_t budget;
+  double push_time;
+} RewindStats;
+
+REWIND rewind_init(size_t);
+void rewind_destroy(REWIND);
+void rewind_push(REWIND, CHIP8);
+bool rewind_pop(REWIND, CHIP8);
+void rewind_clear(REWIND);
+RewindStats rewind_get_stats(REWIND);
+
+#endif
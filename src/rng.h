@@ -0,0 +1,35 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+/*
+ * PCG32 (XSH RR). Small enough to live in every machine, so instances
+ * neither share nor lock random state and a seed fully determines Cxkk.
+ */
+#define RNG_MULTIPLIER 6364136223846793005ULL
+#define RNG_INCREMENT 1442695040888963407ULL
+
+typedef struct ChipRng {
+  uint64_t state;
+} ChipRng;
+
+static inline uint32_t rng_next(ChipRng *rng) {
+  uint64_t old = rng->state;
+  uint32_t xorshifted, rot;
+
+  rng->state = old * RNG_MULTIPLIER + RNG_INCREMENT;
+  xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+  rot = (uint32_t)(old >> 59);
+
+  return xorshifted >> rot | xorshifted << ((32 - rot) & 31);
+}
+
+static inline void rng_seed(ChipRng *rng, uint64_t seed) {
+  rng->state = 0;
+  rng_next(rng);
+  rng->state += seed;
+  rng_next(rng);
+}
+
+#endif
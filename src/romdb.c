@@ -0,0 +1,236 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "romdb.h"
+#include "containers.h"
+#include "utils.h"
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define HASH_DIGITS 16
+
+struct romdb {
+  HashTable *table;
+};
+
+/* Reads the whole file, normally with a single read. */
+static char *read_text(const char *path, size_t *size) {
+  struct stat st;
+  char *text;
+  size_t done = 0;
+  int fd = open(path, O_RDONLY);
+
+  if (fd < 0)
+    return NULL;
+
+  if (fstat(fd, &st) != 0 || (text = malloc(st.st_size + 1)) == NULL) {
+    close(fd);
+    return NULL;
+  }
+
+  while (done < (size_t)st.st_size) {
+    ssize_t n = read(fd, text + done, st.st_size - done);
+
+    if (n <= 0)
+      break;
+    done += n;
+  }
+  close(fd);
+
+  if (done != (size_t)st.st_size) {
+    free(text);
+    return NULL;
+  }
+  text[done] = '\0';
+  *size = done;
+  return text;
+}
+
+static bool parse_keys(const char *value, uint8_t *keys) {
+  if (strlen(value) != 16)
+    return false;
+
+  for (uint8_t i = 0; i < 16; i++) {
+    if (!isalnum((unsigned char)value[i]))
+      return false;
+    keys[i] = toupper((unsigned char)value[i]);
+  }
+
+  return true;
+}
+
+static bool parse_quirks(char *value, uint8_t *quirks) {
+  *quirks = 0;
+
+  for (char *name = value, *next; name; name = next) {
+    uint8_t *quirk;
+    bool known;
+
+    next = strchr(name, ',');
+    if (next != NULL)
+      *next++ = '\0';
+    if (*name == '\0')
+      return false;
+
+    quirk = parse_chip_quirk_arg_value(NULL, name, NULL);
+    known = *quirk != 0;
+    *quirks |= *quirk;
+    free(quirk);
+    if (!known)
+      return false;
+  }
+
+  return true;
+}
+
+/* Returns NULL or why the setting is wrong. */
+static const char *parse_setting(char *field, RomProfile *profile) {
+  char *value = strchr(field, '=');
+  char *end;
+
+  if (value == NULL)
+    return "expected key=value";
+  *value++ = '\0';
+
+  if (strcmp(field, "core") == 0) {
+    profile->core = chip_find_core(value);
+    return profile->core ? NULL : "unknown core";
+  } else if (strcmp(field, "quirks") == 0) {
+    profile->quirks_set = parse_quirks(value, &profile->quirks);
+    return profile->quirks_set ? NULL : "unknown quirk";
+  } else if (strcmp(field, "cpf") == 0) {
+    unsigned long cpf = strtoul(value, &end, 10);
+
+    profile->cpf = cpf;
+    return end != value && *end == '\0' && cpf > 0 && cpf <= UINT16_MAX
+               ? NULL
+               : "wrong cpf";
+  } else if (strcmp(field, "keys") == 0) {
+    profile->keys_set = parse_keys(value, profile->keys);
+    return profile->keys_set ? NULL : "keys must be 16 letters or digits";
+  }
+
+  return "unknown setting";
+}
+
+/* Adds the rom of one line. Returns NULL or why the line is wrong. */
+static const char *parse_line(HashTable *table, char *line) {
+  char *field = strtok(line, " \t\r");
+  RomProfile *profile;
+  const char *error;
+  uint64_t hash;
+
+  if (strlen(field) > HASH_DIGITS ||
+      strspn(field, "0123456789abcdefABCDEF") != strlen(field))
+    return "wrong hash";
+  hash = strtoull(field, NULL, 16);
+
+  profile = Arena_alloc(&table->arena, sizeof(RomProfile));
+  if (profile == NULL)
+    return "out of memory";
+  memset(profile, 0, sizeof(RomProfile));
+
+  while ((field = strtok(NULL, " \t\r")) != NULL)
+    if ((error = parse_setting(field, profile)) != NULL)
+      return error;
+
+  if (!HashTable_put(table, &hash, sizeof(hash), profile))
+    return "out of memory";
+  return NULL;
+}
+
+/*
+ * Reads and indexes the database. Broken lines are skipped with a warning.
+ * Returns NULL or an error, in which case no database is opened.
+ */
+const char *romdb_load(const char *path, ROMDB *db) {
+  size_t size, lines = 0, lineno = 0;
+  char *text = read_text(path, &size);
+  ROMDB rdb;
+
+  if (text == NULL)
+    return "Failed to read the rom database";
+
+  for (char *c = text; (c = memchr(c, '\n', text + size - c)) != NULL; c++)
+    lines++;
+
+  rdb = malloc(sizeof(struct romdb));
+  if (rdb == NULL || (rdb->table = HashTable_create(lines + 1)) == NULL) {
+    free(rdb);
+    free(text);
+    return "Failed to allocate memory";
+  }
+
+  for (char *line = text, *next; line < text + size; line = next) {
+    const char *error;
+    char *start;
+
+    next = strchr(line, '\n');
+    if (next != NULL)
+      *next++ = '\0';
+    else
+      next = text + size;
+    lineno++;
+
+    start = line + strspn(line, " \t\r");
+    if (*start == '#' || *start == '\0')
+      continue;
+
+    if ((error = parse_line(rdb->table, start)) != NULL)
+      printf("WARNING: %s line %zu: %s\n", path, lineno, error);
+  }
+
+  free(text);
+  *db = rdb;
+  return NULL;
+}
+
+size_t romdb_count(ROMDB db) { return db->table->count; }
+
+/* Returns the settings for the rom with the hash, or NULL. */
+const RomProfile *romdb_find(ROMDB db, uint64_t hash) {
+  return HashTable_get(db->table, &hash, sizeof(hash));
+}
+
+void romdb_close(ROMDB db) {
+  HashTable_destroy(db->table);
+  free(db);
+}
+
+/*
+ * Configures the run of the rom with the hash from the database at path.
+ * The core and quirks given on the command line win over the database ones,
+ * and so does a command line speed. found tells if the rom was in the
+ * database. Returns NULL or an error.
+ */
+const char *romdb_configure(const char *path, uint64_t hash, Config *config,
+                            bool *found) {
+  const RomProfile *profile;
+  const char *error;
+  ROMDB db;
+
+  if ((error = romdb_load(path, &db)) != NULL)
+    return error;
+
+  profile = romdb_find(db, hash);
+  *found = profile != NULL;
+  if (profile != NULL) {
+    if (config->core == NULL)
+      config->core = profile->core;
+    if (!config->chip_quirks_set && profile->quirks_set)
+      config->chip_quirks = profile->quirks;
+    if (config->cpf == 0)
+      config->cpf = profile->cpf;
+    if (profile->keys_set) {
+      memcpy(config->keys, profile->keys, sizeof(config->keys));
+      config->keys_set = true;
+    }
+  }
+
+  romdb_close(db);
+  return NULL;
+}
@@ -0,0 +1,37 @@
+#ifndef ROMDB_H
+#define ROMDB_H
+
+#include "chip.h"
+#include "config.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Rom databases: a text file with one line per rom,
+ * "<hash> [core=name] [quirks=a,b] [cpf=N] [keys=XXXXXXXXXXXXXXXX]", where
+ * hash is the hash_bytes of the rom in hex. Lines starting with # are
+ * ignored. The file is read in one go and indexed by hash.
+ */
+typedef struct romdb *ROMDB;
+
+/*
+ * The settings a database has for a rom. core is NULL and cpf 0 when it
+ * doesn't set them, quirks and keys only apply when their flag is set. keys
+ * holds the keyboard key of every Chip-8 key, like input_keys.
+ */
+typedef struct RomProfile {
+  const ChipCore *core;
+  uint16_t cpf;
+  uint8_t quirks;
+  bool quirks_set;
+  uint8_t keys[16];
+  bool keys_set;
+} RomProfile;
+
+const char *romdb_load(const char *, ROMDB *);
+size_t romdb_count(ROMDB);
+const RomProfile *romdb_find(ROMDB, uint64_t);
+void romdb_close(ROMDB);
+const char *romdb_configure(const char *, uint64_t, Config *, bool *);
+
+#endif
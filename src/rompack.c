@@ -0,0 +1,277 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "rompack.h"
+#include "utils.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define ROMPACK_MAGIC "C8PK"
+#define CORE_NAME_SIZE 12
+#define DATA_ALIGN 8
+
+const char rompack_not_a_pack[] = "Not a rom pack";
+
+typedef struct PackHeader {
+  char magic[4];
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t count;
+  uint32_t names_size;
+  uint64_t data_offset;
+} PackHeader;
+
+/*
+ * offset counts from the start of the rom bytes and name from the start of
+ * the names. An empty core means no recommendation.
+ */
+typedef struct PackEntry {
+  uint64_t hash;
+  uint64_t offset;
+  uint32_t size;
+  uint32_t name;
+  char core[CORE_NAME_SIZE];
+  uint8_t quirks;
+  uint8_t quirks_set;
+  uint8_t reserved[2];
+} PackEntry;
+
+struct rompack {
+  const uint8_t *map;
+  size_t map_size;
+  const PackEntry *entries;
+  uint32_t count;
+  const char *names;
+  uint32_t names_size;
+  const uint8_t *data;
+  uint64_t data_size;
+};
+
+static const char *check_header(const PackHeader *header, size_t size) {
+  uint64_t index_end;
+
+  if (memcmp(header->magic, ROMPACK_MAGIC, sizeof(header->magic)) != 0)
+    return rompack_not_a_pack;
+  if (header->version != ROMPACK_VERSION)
+    return "Rom pack was written by another version";
+
+  index_end = sizeof(PackHeader) +
+              (uint64_t)header->count * sizeof(PackEntry) + header->names_size;
+  if (index_end > header->data_offset || header->data_offset > size)
+    return "Rom pack is truncated";
+  if (header->count > 0 &&
+      (header->names_size == 0 ||
+       ((const char *)header)[index_end - 1] != '\0'))
+    return "Rom pack index is broken";
+
+  return NULL;
+}
+
+/*
+ * Maps the whole file; every later lookup only reads the mapping. Returns
+ * NULL or an error, in which case no pack is opened.
+ */
+const char *rompack_open(const char *path, ROMPACK *pack) {
+  const PackHeader *header;
+  const char *error;
+  struct stat st;
+  ROMPACK rp;
+  void *map;
+  int fd;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return "Failed to open file";
+
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(PackHeader)) {
+    close(fd);
+    return rompack_not_a_pack;
+  }
+
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return "Failed to map the rom pack";
+
+  header = map;
+  error = check_header(header, st.st_size);
+  if (error == NULL && (rp = malloc(sizeof(struct rompack))) == NULL)
+    error = "Failed to allocate memory";
+  if (error != NULL) {
+    munmap(map, st.st_size);
+    return error;
+  }
+
+  rp->map = map;
+  rp->map_size = st.st_size;
+  rp->entries = (const PackEntry *)(header + 1);
+  rp->count = header->count;
+  rp->names = (const char *)(rp->entries + rp->count);
+  rp->names_size = header->names_size;
+  rp->data = rp->map + header->data_offset;
+  rp->data_size = rp->map_size - header->data_offset;
+
+  *pack = rp;
+  return NULL;
+}
+
+size_t rompack_count(ROMPACK pack) { return pack->count; }
+
+/* Returns false when the entry points outside of the pack. */
+static bool read_entry(ROMPACK pack, const PackEntry *entry, PackRom *rom) {
+  char core[CORE_NAME_SIZE];
+
+  if (entry->name >= pack->names_size || entry->size > ROM_MAX_SIZE ||
+      entry->offset > pack->data_size ||
+      entry->size > pack->data_size - entry->offset)
+    return false;
+
+  memcpy(core, entry->core, CORE_NAME_SIZE);
+  core[CORE_NAME_SIZE - 1] = '\0';
+
+  rom->name = pack->names + entry->name;
+  rom->data = pack->data + entry->offset;
+  rom->size = entry->size;
+  rom->hash = entry->hash;
+  rom->core = core[0] ? chip_find_core(core) : NULL;
+  rom->quirks = entry->quirks;
+  rom->quirks_set = entry->quirks_set;
+
+  return true;
+}
+
+bool rompack_get(ROMPACK pack, size_t index, PackRom *rom) {
+  return index < pack->count && read_entry(pack, &pack->entries[index], rom);
+}
+
+/* A binary search over the index, which is sorted by name. */
+bool rompack_find(ROMPACK pack, const char *name, PackRom *rom) {
+  size_t lo = 0, hi = pack->count;
+
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    const PackEntry *entry = &pack->entries[mid];
+    int cmp;
+
+    if (entry->name >= pack->names_size)
+      return false;
+
+    cmp = strcmp(name, pack->names + entry->name);
+    if (cmp == 0)
+      return read_entry(pack, entry, rom);
+    if (cmp < 0)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+
+  return false;
+}
+
+void rompack_close(ROMPACK pack) {
+  munmap((void *)pack->map, pack->map_size);
+  free(pack);
+}
+
+static int compare_names(const void *a, const void *b) {
+  return strcmp(((const PackRom *)a)->name, ((const PackRom *)b)->name);
+}
+
+static bool write_pack(FILE *file, const PackRom *roms, size_t count,
+                       const PackHeader *header) {
+  static const uint8_t padding[DATA_ALIGN];
+  uint64_t offset = 0;
+  uint32_t name = 0;
+  size_t pad;
+
+  if (fwrite(header, sizeof(PackHeader), 1, file) != 1)
+    return false;
+
+  for (size_t i = 0; i < count; i++) {
+    PackEntry entry;
+
+    memset(&entry, 0, sizeof(entry));
+    entry.hash = hash_bytes(roms[i].data, roms[i].size);
+    entry.offset = offset;
+    entry.size = roms[i].size;
+    entry.name = name;
+    if (roms[i].core != NULL)
+      strncpy(entry.core, roms[i].core->name, CORE_NAME_SIZE - 1);
+    entry.quirks = roms[i].quirks;
+    entry.quirks_set = roms[i].quirks_set;
+
+    if (fwrite(&entry, sizeof(entry), 1, file) != 1)
+      return false;
+    offset += roms[i].size;
+    name += strlen(roms[i].name) + 1;
+  }
+
+  for (size_t i = 0; i < count; i++)
+    if (fwrite(roms[i].name, strlen(roms[i].name) + 1, 1, file) != 1)
+      return false;
+
+  pad = header->data_offset - sizeof(PackHeader) -
+        count * sizeof(PackEntry) - name;
+  if (pad && fwrite(padding, pad, 1, file) != 1)
+    return false;
+
+  for (size_t i = 0; i < count; i++)
+    if (roms[i].size && fwrite(roms[i].data, roms[i].size, 1, file) != 1)
+      return false;
+
+  return true;
+}
+
+/*
+ * Sorts the roms by name and writes them as a pack, through a temporary
+ * file that is renamed over path. The hashes are computed here. Returns
+ * NULL or an error.
+ */
+const char *rompack_write(const char *path, PackRom *roms, size_t count) {
+  char tmp_path[FILENAME_MAX];
+  PackHeader header;
+  uint64_t names_size = 0;
+  FILE *file;
+  bool ok;
+
+  if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >=
+      (int)sizeof(tmp_path))
+    return "Rom pack path is too long";
+
+  qsort(roms, count, sizeof(PackRom), &compare_names);
+  for (size_t i = 0; i < count; i++) {
+    if (i > 0 && strcmp(roms[i - 1].name, roms[i].name) == 0)
+      return "Two roms have the same name";
+    if (roms[i].size > ROM_MAX_SIZE)
+      return "A rom does not fit into memory";
+    names_size += strlen(roms[i].name) + 1;
+  }
+  if (count > UINT32_MAX || names_size > UINT32_MAX)
+    return "Too many roms for one pack";
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, ROMPACK_MAGIC, sizeof(header.magic));
+  header.version = ROMPACK_VERSION;
+  header.count = count;
+  header.names_size = names_size;
+  header.data_offset = sizeof(PackHeader) + count * sizeof(PackEntry) +
+                       names_size + DATA_ALIGN - 1;
+  header.data_offset -= header.data_offset % DATA_ALIGN;
+
+  file = fopen(tmp_path, "wb");
+  if (file == NULL)
+    return "Failed to open the rom pack file";
+
+  ok = write_pack(file, roms, count, &header) && fflush(file) == 0;
+  ok &= fclose(file) == 0;
+
+  if (!ok || rename(tmp_path, path) != 0) {
+    remove(tmp_path);
+    return "Failed to write the rom pack file";
+  }
+
+  return NULL;
+}
@@ -0,0 +1,44 @@
+#ifndef ROMPACK_H
+#define ROMPACK_H
+
+#include "chip.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * Rom packs: many roms in a single file, made by chipo8o-pack. A header is
+ * followed by an index sorted by rom name, the names and then the rom
+ * bytes. A pack is mapped once on open, so finding a rom is a binary search
+ * over the mapping and loading it needs no further syscalls.
+ */
+#define ROMPACK_VERSION 1
+
+typedef struct rompack *ROMPACK;
+
+/*
+ * A rom and what the pack recommends running it with. data points into the
+ * mapping and stays valid until the pack is closed. core is NULL when the
+ * pack doesn't recommend one, quirks only apply when quirks_set is true.
+ */
+typedef struct PackRom {
+  const char *name;
+  const uint8_t *data;
+  size_t size;
+  uint64_t hash;
+  const ChipCore *core;
+  uint8_t quirks;
+  bool quirks_set;
+} PackRom;
+
+/* The error of rompack_open for a file that isn't a rom pack at all. */
+extern const char rompack_not_a_pack[];
+
+const char *rompack_open(const char *, ROMPACK *);
+size_t rompack_count(ROMPACK);
+bool rompack_get(ROMPACK, size_t, PackRom *);
+bool rompack_find(ROMPACK, const char *, PackRom *);
+void rompack_close(ROMPACK);
+const char *rompack_write(const char *, PackRom *, size_t);
+
+#endif
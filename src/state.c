@@ -0,0 +1,121 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "state.h"
+#include "utils.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define STATE_MAGIC "C8ST"
+#define BACKEND_NAME_SIZE 12
+
+typedef struct StateHeader {
+  char magic[4];
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t state_size;
+  char backend[BACKEND_NAME_SIZE];
+  uint64_t checksum;
+} StateHeader;
+
+/*
+ * Writes a temporary file and renames it over the old one, so a crash while
+ * saving never leaves a broken slot behind. Returns NULL or an error.
+ */
+const char *state_save(CHIP8 chip, const char *path) {
+  char tmp_path[FILENAME_MAX];
+  StateHeader header;
+  ChipState state;
+  FILE *file;
+  bool ok;
+
+  if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >=
+      (int)sizeof(tmp_path))
+    return "Save state path is too long";
+
+  chip_save_state(chip, &state);
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, STATE_MAGIC, sizeof(header.magic));
+  header.version = STATE_VERSION;
+  header.state_size = sizeof(ChipState);
+  strncpy(header.backend, chip_backend_name(chip), BACKEND_NAME_SIZE - 1);
+  header.checksum = hash_bytes(&state, sizeof(state));
+
+  file = fopen(tmp_path, "wb");
+  if (file == NULL)
+    return "Failed to open the save state file";
+
+  ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+       fwrite(&state, sizeof(state), 1, file) == 1 && fflush(file) == 0 &&
+       fsync(fileno(file)) == 0;
+  ok &= fclose(file) == 0;
+
+  if (!ok || rename(tmp_path, path) != 0) {
+    remove(tmp_path);
+    return "Failed to write the save state file";
+  }
+
+  return NULL;
+}
+
+static const char *check_header(const StateHeader *header, CHIP8 chip) {
+  if (memcmp(header->magic, STATE_MAGIC, sizeof(header->magic)) != 0)
+    return "Not a save state file";
+  if (header->version != STATE_VERSION ||
+      header->state_size != sizeof(ChipState))
+    return "Save state was written by another version";
+  if (strncmp(header->backend, chip_backend_name(chip),
+              BACKEND_NAME_SIZE) != 0)
+    return "Save state was written by another core";
+
+  return NULL;
+}
+
+/*
+ * Maps the file and loads the chip straight from the mapping. Returns NULL
+ * or an error, in which case the chip is left as it was.
+ */
+const char *state_load(CHIP8 chip, const char *path) {
+  const size_t size = sizeof(StateHeader) + sizeof(ChipState);
+  const StateHeader *header;
+  const ChipState *state;
+  const char *error;
+  struct stat st;
+  void *map;
+  int fd;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return "Failed to open the save state file";
+
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size != size) {
+    close(fd);
+    return "Save state file has the wrong size";
+  }
+
+  map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return "Failed to map the save state file";
+
+  header = map;
+  state = (const ChipState *)(header + 1);
+
+  error = check_header(header, chip);
+  if (error == NULL && hash_bytes(state, sizeof(ChipState)) != header->checksum)
+    error = "Save state checksum mismatch";
+  if (error == NULL && !chip_load_state(chip, state))
+    error = "Save state doesn't fit this chip";
+
+  munmap(map, size);
+  return error;
+}
+
+/* Slot n of a rom lives next to it, as <rom>.<n>.state. */
+void state_slot_path(char *path, size_t size, const char *rom, uint16_t slot) {
+  snprintf(path, size, "%s.%u.state", rom, slot);
+}
@@ -0,0 +1,19 @@
+#ifndef STATE_H
+#define STATE_H
+
+#include "chip.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Save state files: a StateHeader followed by a ChipState. The header names
+ * the core and carries an FNV-1a checksum of the state, files from
+ * another version, core or build are refused.
+ */
+#define STATE_VERSION 2
+
+const char *state_save(CHIP8, const char *);
+const char *state_load(CHIP8, const char *);
+void state_slot_path(char *, size_t, const char *, uint16_t);
+
+#endif
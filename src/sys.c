@@ -4,8 +4,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-#define FREQ_DEFAULT 20
-#define FREQ_INCREASE 50
+#define FREQ_DEFAULT 1200
+#define FREQ_INCREASE 3000
 
 SYS *sys_init() {
   SYS *sys = malloc(sizeof(SYS));
@@ -13,28 +13,29 @@ SYS *sys_init() {
   if (sys == NULL)
     terminate("Failed to allocate memory");
 
-  sys->chip_cycles_left = FREQ_DEFAULT;
   sys->chip_freq = FREQ_DEFAULT;
   sys->show_fps = false;
 
   return sys;
 }
 
+/*
+ * chip_freq is the instruction rate in Hz. It is read by the emulation
+ * thread, only this thread writes it.
+ */
 void sys_inc_freq(SYS *sys) {
-  sys->chip_freq += FREQ_INCREASE;
-  printf("CPF: %d\n", sys->chip_freq);
+  __atomic_store_n(&sys->chip_freq, sys->chip_freq + FREQ_INCREASE,
+                   __ATOMIC_RELAXED);
+  printf("Speed: %u Hz\n", sys->chip_freq);
 }
 
 void sys_dec_freq(SYS *sys) {
   if (sys->chip_freq <= FREQ_INCREASE)
-    sys->chip_freq = FREQ_DEFAULT;
+    __atomic_store_n(&sys->chip_freq, FREQ_DEFAULT, __ATOMIC_RELAXED);
   else
-    sys->chip_freq -= FREQ_INCREASE;
-  printf("CPF: %d\n", sys->chip_freq);
+    __atomic_store_n(&sys->chip_freq, sys->chip_freq - FREQ_INCREASE,
+                     __ATOMIC_RELAXED);
+  printf("Speed: %u Hz\n", sys->chip_freq);
 }
 
-bool sys_is_chip_active(SYS *sys) { return sys->chip_cycles_left-- > 0; }
-
-void sys_reset_cycles(SYS *sys) { sys->chip_cycles_left = sys->chip_freq; }
-
 void sys_destroy(SYS *sys) { free(sys); }
@@ -4,13 +4,12 @@
 #include <stdlib.h>
 #include <string.h>
 
-RomData read_rom_file(char *filename) {
+/* Returns NULL on success or a message describing the failure. */
+const char *load_rom_file(const char *filename, RomData *rd) {
   FILE *fp = fopen(filename, "rb");
 
-  if (!fp) {
-    printf("Failed to open %s\n", filename);
-    exit(EXIT_FAILURE);
-  }
+  if (!fp)
+    return "Failed to open file";
 
   fseek(fp, 0L, SEEK_END);
   size_t size = ftell(fp);
@@ -20,7 +19,7 @@ RomData read_rom_file(char *filename) {
 
   if (rom_data == NULL) {
     fclose(fp);
-    terminate("Failed to allocate memory for rom data");
+    return "Failed to allocate memory for rom data";
   }
 
   size_t total_read = fread(rom_data, sizeof(uint8_t), size, fp);
@@ -28,14 +27,33 @@ RomData read_rom_file(char *filename) {
   if (total_read != size) {
     free(rom_data);
     fclose(fp);
-    terminate("Failed to read file");
+    return "Failed to read file";
   }
 
   fclose(fp);
 
-  RomData result = {.data = rom_data, .size = size};
+  rd->data = rom_data;
+  rd->size = size;
+
+  return NULL;
+}
+
+RomData read_rom_file(char *filename) {
+  RomData rd;
+  const char *err = load_rom_file(filename, &rd);
+
+  if (err != NULL) {
+    printf("%s: %s\n", filename, err);
+    exit(EXIT_FAILURE);
+  }
+
+  if (rd.size > ROM_MAX_SIZE) {
+    free(rd.data);
+    printf("%s: rom does not fit into memory\n", filename);
+    exit(EXIT_FAILURE);
+  }
 
-  return result;
+  return rd;
 }
 
 void terminate(const char *msg) {
@@ -43,6 +61,55 @@ void terminate(const char *msg) {
   exit(EXIT_FAILURE);
 }
 
+/* 64-bit FNV-1a. */
+uint64_t hash_bytes(const void *data, size_t size) {
+  const uint8_t *bytes = data;
+  uint64_t hash = 0xCBF29CE484222325ULL;
+
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001B3ULL;
+  }
+
+  return hash;
+}
+
+const char *chip_status_name(ChipStatus status) {
+  switch (status) {
+  case CHIP_RUNNING:
+    return "running";
+  case CHIP_EXITED:
+    return "exit";
+  case CHIP_UNSUPPORTED_OPCODE:
+    return "unsupported";
+  case CHIP_STACK_OVERFLOW:
+    return "stack-overflow";
+  case CHIP_WAITING_VBLANK:
+    return "vblank";
+  default:
+    return "unknown";
+  }
+}
+
+/* Exits the process once the chip has halted, as the cores used to do. */
+void check_chip_status(CHIP8 chip) {
+  switch (chip_get_status(chip)) {
+  case CHIP_EXITED:
+    terminate("Executing 00FD. Bye.");
+    break;
+  case CHIP_UNSUPPORTED_OPCODE:
+    printf("WARNING: unsupported opcode at %03X\n", chip_get_pc(chip));
+    exit(EXIT_FAILURE);
+    break;
+  case CHIP_STACK_OVERFLOW:
+    printf("WARNING: stack overflow at %03X\n", chip_get_pc(chip));
+    exit(EXIT_FAILURE);
+    break;
+  default:
+    break;
+  }
+}
+
 void chip_handler(InputHandler *h) {
   CHIP8 chip = h->ctx;
 
@@ -101,6 +168,10 @@ void register_input_handlers(MEDIA media, SYS *sys, CHIP8 chip) {
     media_register_input_handler(media, uh);
   }
 
+  register_hotkey_handlers(media, sys);
+}
+
+void register_hotkey_handlers(MEDIA media, SYS *sys) {
   InputHandler ih = {.keycode = '=',
                      .alt = INCREMENT_CHIP_FREQ,
                      .event = PRESSED,
@@ -170,6 +241,60 @@ void *parse_chip_quirk_arg_value(char *key, char *value, void *optsp) {
   return (void *)val;
 }
 
+void *parse_renderer_arg_value(char *key, char *value, void *optsp) {
+  if (value == NULL)
+    terminate("Missing value for renderer arg");
+
+  MediaRenderer *val = malloc(sizeof(MediaRenderer));
+
+  if (strcmp(value, "texture") == 0)
+    *val = RENDER_TEXTURE;
+  else if (strcmp(value, "rects") == 0)
+    *val = RENDER_RECTANGLES;
+  else
+    terminate("Wrong value for renderer arg");
+
+  return (void *)val;
+}
+
+void *parse_core_arg_value(char *key, char *value, void *optsp) {
+  if (value == NULL)
+    terminate("Missing value for core arg");
+
+  const ChipCore **val = malloc(sizeof(const ChipCore *));
+
+  *val = chip_find_core(value);
+  if (*val == NULL)
+    terminate("Wrong value for core arg");
+
+  return (void *)val;
+}
+
+void *parse_uint_arg_value(char *key, char *value, void *optsp) {
+  char *end;
+
+  if (value == NULL)
+    terminate("Missing value for numeric arg");
+
+  unsigned long long *val = malloc(sizeof(unsigned long long));
+  *val = strtoull(value, &end, 10);
+
+  if (end == value || *end != '\0')
+    terminate("Wrong value for numeric arg");
+
+  return (void *)val;
+}
+
+void *parse_string_arg_value(char *key, char *value, void *optsp) {
+  if (value == NULL)
+    terminate("Missing value for string arg");
+
+  char **val = malloc(sizeof(char *));
+  *val = value;
+
+  return (void *)val;
+}
+
 void *display_help_message(char *key, char *value, void *optsp) {
   ArgParserOptions *opts = (ArgParserOptions *)optsp;
 
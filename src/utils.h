@@ -16,11 +16,20 @@ typedef struct {
   size_t size;
 } RomData;
 
+const char *load_rom_file(const char *, RomData *);
 RomData read_rom_file(char *);
 void terminate(const char *);
+uint64_t hash_bytes(const void *, size_t);
+const char *chip_status_name(ChipStatus);
+void check_chip_status(CHIP8);
 void register_input_handlers(MEDIA, SYS *, CHIP8);
+void register_hotkey_handlers(MEDIA, SYS *);
 void *parse_color_arg_value(char *, char *, void *);
 void *parse_chip_quirk_arg_value(char *, char *, void *);
+void *parse_renderer_arg_value(char *, char *, void *);
+void *parse_core_arg_value(char *, char *, void *);
+void *parse_uint_arg_value(char *, char *, void *);
+void *parse_string_arg_value(char *, char *, void *);
 void *display_help_message(char *, char *, void *);
 
 #endif
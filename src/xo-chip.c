@@ -0,0 +1,6 @@
+#define CHIP_SUPER_CHIP
+#define CHIP_XO_CHIP
+#define CORE_TABLE xo_chip_core
+#define CORE_OPTABLE "optable-xo-chip.h"
+
+#include "chip-core.h"